@@ -0,0 +1,1317 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "anagram.h"
+#include "histogram.h"
+#include "internal.h"
+
+// Size of the window in which the dictionary file is read. This is not the
+// maximum file size, but it is the maximum line length.
+#define DICTFILE_CHUNK	10000
+
+// One level of the search.
+struct frame {
+
+	// What is left of the input at this level.
+	struct histogram *hist;
+
+	// Offset in the cursor's #found array of the words that fit in #hist.
+	size_t base;
+
+	// Number of words that fit in #hist.
+	size_t n;
+
+	// Position of the next word to try.
+	size_t next;
+
+	// Whether the length requirement is satisfied by the words so far.
+	bool satisfied;
+};
+
+struct anagram_cursor {
+
+	// The query which this cursor iterates over.
+	const struct anagram_query *query;
+
+	// Stack of search levels, and number of levels in use. Every word takes
+	// at least one character, so there are never more levels than there
+	// are characters in the input.
+	struct frame *frames;
+	size_t nframes;
+
+	// One preallocated histogram per level, plus one for the level below
+	// the deepest.
+	struct histogram **hists;
+
+	// Stack of indices of the words that fit at each level. Each level
+	// pushes its words on entry and pops them on exit.
+	uint32_t *found;
+
+	// Number of entries in use and allocated in #found.
+	size_t found_used;
+	size_t found_size;
+
+	// Stack of words in the current branch of the search. The included
+	// words are at the bottom of the stack.
+	const struct anagram_word **stack;
+
+	// The letters left over by the current result, in partial mode.
+	char *leftover;
+
+	// The letters which the wildcards stand for in the current result.
+	char *blanks;
+
+	// Scratch bitsets of word lengths and of reachable sums of word
+	// lengths, and a scratch array of distinct word lengths, used by the
+	// feasibility checks.
+	uint64_t *lenbits;
+	uint64_t *reach;
+	size_t *lens;
+
+	// Search statistics.
+	struct anagram_search_stats stats;
+
+	// Maximum number of levels to enter per call, zero if unlimited.
+	size_t limit;
+
+	// Whether the search has started, and whether it has finished.
+	bool started;
+	bool done;
+};
+
+const struct anagram_dict_opts anagram_dict_opts_default = {
+	.filter     = NULL,
+	.filter_len = 0,
+	.normalize  = false,
+	.minlength  = 0,
+};
+
+const struct anagram_query_opts anagram_query_opts_default = {
+	.minlength = 1,
+	.haslength = 1,
+	.include   = NULL,
+	.ninclude  = 0,
+	.generator = ANAGRAM_GENERATOR_TRIE,
+	.partial   = false,
+	.minused   = 0,
+};
+
+static int
+char_compare (const void *const p1, const void *const p2)
+{
+	if (*(const char *) p1 == *(const char *) p2) {
+		return 0;
+	}
+	return (*(const char *) p1 < *(const char *) p2) ? -1 : 1;
+}
+
+struct anagram_dict *
+anagram_dict_create (const struct anagram_dict_opts *opts)
+{
+	struct anagram_dict *dict;
+
+	if (opts == NULL) {
+		opts = &anagram_dict_opts_default;
+	}
+
+	if ((dict = calloc(1, sizeof(*dict))) == NULL) {
+		return NULL;
+	}
+
+	dict->normalize = opts->normalize;
+	dict->minlength = opts->minlength;
+	dict->checksum  = FNV64_INIT;
+
+	if (!wordset_init(&dict->exclude)) {
+		goto err_0;
+	}
+
+	if (!wordset_init(&dict->unique)) {
+		goto err_1;
+	}
+
+	if (!trie_init(&dict->trie)) {
+		goto err_2;
+	}
+
+	if (opts->filter != NULL && opts->filter_len > 0) {
+		if ((dict->filter = histogram_create(opts->filter, opts->filter_len)) == NULL) {
+			goto err_3;
+		}
+	}
+
+	return dict;
+
+err_3:	trie_free(&dict->trie);
+err_2:	wordset_free(&dict->unique);
+err_1:	wordset_free(&dict->exclude);
+err_0:	free(dict);
+	return NULL;
+}
+
+void
+trim (const char **str, size_t *len)
+{
+	while (*len > 0 && isspace((unsigned char) **str)) {
+		(*str)++;
+		(*len)--;
+	}
+
+	while (*len > 0 && isspace((unsigned char) (*str)[*len - 1])) {
+		(*len)--;
+	}
+}
+
+// Return a heap-allocated, NUL-terminated copy of a word, normalized if the
+// dictionary requires it.
+static char *
+word_copy (const struct anagram_dict *dict, const char *str, size_t len)
+{
+	char *copy;
+
+	if ((copy = malloc(len + 1)) == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		copy[i] = dict->normalize ? tolower((unsigned char) str[i]) : str[i];
+	}
+
+	copy[len] = '\0';
+	return copy;
+}
+
+bool
+read_lines (const char *path, bool (*handler) (void *, const char *, size_t), void *arg)
+{
+	char buf[DICTFILE_CHUNK];
+	size_t fill = 0;
+	bool overlong = false;
+	bool eof = false;
+	bool ret = true;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		return false;
+	}
+
+	while (ret && !eof) {
+		const size_t nread = fread(buf + fill, 1, sizeof(buf) - fill, fp);
+		char *anchor = buf;
+		char *nl;
+
+		eof   = nread == 0;
+		fill += nread;
+
+		// Split on newlines.
+		while ((nl = memchr(anchor, '\n', fill - (anchor - buf))) != NULL) {
+			if (overlong) {
+				overlong = false;
+			} else if (!handler(arg, anchor, nl - anchor)) {
+				ret = false;
+				break;
+			}
+			anchor = nl + 1;
+		}
+
+		// Handle a last line without a trailing newline.
+		if (ret && eof && anchor < buf + fill && !overlong) {
+			ret = handler(arg, anchor, fill - (anchor - buf));
+			anchor = buf + fill;
+		}
+
+		// Move the remainder to the front of the buffer.
+		fill -= anchor - buf;
+		memmove(buf, anchor, fill);
+
+		// Skip lines that do not fit in the buffer.
+		if (fill == sizeof(buf)) {
+			overlong = true;
+			fill = 0;
+		}
+	}
+
+	if (ferror(fp)) {
+		ret = false;
+	}
+
+	fclose(fp);
+	return ret;
+}
+
+bool
+anagram_dict_exclude_word (struct anagram_dict *dict, const char *str, size_t len)
+{
+	bool added;
+	char *copy;
+
+	if (dict->normalize) {
+		trim(&str, &len);
+	}
+
+	if (len == 0) {
+		return true;
+	}
+
+	if ((copy = word_copy(dict, str, len)) == NULL) {
+		return false;
+	}
+
+	if (!wordset_add(&dict->exclude, copy, len, &added)) {
+		free(copy);
+		return false;
+	}
+
+	if (!added) {
+		free(copy);
+	}
+
+	return true;
+}
+
+static bool
+dict_exclude_line (void *dict, const char *line, size_t len)
+{
+	return anagram_dict_exclude_word(dict, line, len);
+}
+
+bool
+anagram_dict_exclude_file (struct anagram_dict *dict, const char *path)
+{
+	return read_lines(path, dict_exclude_line, dict);
+}
+
+static bool
+dict_grow (struct anagram_dict *dict)
+{
+	const size_t size = dict->size ? dict->size * 2 : 1024;
+	struct word *words;
+
+	if ((words = realloc(dict->words, size * sizeof(*words))) == NULL) {
+		return false;
+	}
+
+	dict->words = words;
+	dict->size  = size;
+	return true;
+}
+
+bool
+anagram_dict_add_word (struct anagram_dict *dict, const char *str, size_t len)
+{
+	struct histogram *h = NULL;
+	struct word *w;
+	char *copy;
+	bool added;
+
+	if (dict->normalize) {
+		trim(&str, &len);
+	}
+
+	// Empty words are not words.
+	if (len == 0) {
+		return true;
+	}
+
+	dict->stats.offered++;
+
+	// If the word is too short, or longer than the filter string, the
+	// word is out.
+	if (len < dict->minlength || (dict->filter != NULL && len > dict->filter->ntotal)) {
+		return true;
+	}
+
+	if ((copy = word_copy(dict, str, len)) == NULL) {
+		return false;
+	}
+
+	// Drop excluded words.
+	if (wordset_contains(&dict->exclude, copy, len)) {
+		dict->stats.excluded++;
+		goto skip;
+	}
+
+	// Drop words that are already in the dictionary.
+	if (wordset_contains(&dict->unique, copy, len)) {
+		dict->stats.duplicates++;
+		goto skip;
+	}
+
+	if ((h = histogram_create(copy, len)) == NULL) {
+		goto err;
+	}
+
+	// Words with wildcards are not words.
+	if (h->nwild > 0) {
+		goto skip;
+	}
+
+	// If the word has a higher occurrence count for any given character
+	// than the filter, then the word is out.
+	if (dict->filter != NULL && !histogram_fits(h, dict->filter)) {
+		goto skip;
+	}
+
+	if (dict->nwords == dict->size && !dict_grow(dict)) {
+		goto err;
+	}
+
+	if (!wordset_add(&dict->unique, copy, len, &added)) {
+		goto err;
+	}
+
+	// From here on the word is owned by the dictionary.
+	w = &dict->words[dict->nwords++];
+	w->pub.str = copy;
+	w->pub.len = len;
+	w->hist    = h;
+
+	dict->stats.words++;
+
+	// Update the FNV-1a checksum with the word and a separator.
+	dict->checksum = fnv64(dict->checksum, copy, len + 1);
+
+	return trie_insert(&dict->trie, h);
+
+skip:	histogram_destroy(&h);
+	free(copy);
+	return true;
+
+err:	histogram_destroy(&h);
+	free(copy);
+	return false;
+}
+
+static bool
+dict_add_line (void *arg, const char *line, size_t len)
+{
+	struct anagram_dict *dict = arg;
+
+	if (dict->normalize) {
+		trim(&line, &len);
+	}
+
+	// Check if every character is in the list of characters in the filter
+	// string. If not, this word can never be part of an anagram. This is
+	// much cheaper than creating a histogram of the word. If the filter
+	// has wildcards, any character can be part of an anagram.
+	if (dict->filter != NULL && dict->filter->nwild == 0) {
+		for (size_t i = 0; i < len; i++) {
+			const char c = dict->normalize ? tolower((unsigned char) line[i]) : line[i];
+
+			if (bsearch(&c, dict->filter->bins, dict->filter->len, 1, char_compare) == NULL) {
+				dict->stats.offered++;
+				return true;
+			}
+		}
+	}
+
+	return anagram_dict_add_word(dict, line, len);
+}
+
+bool
+anagram_dict_add_file (struct anagram_dict *dict, const char *path)
+{
+	return read_lines(path, dict_add_line, dict);
+}
+
+size_t
+anagram_dict_size (const struct anagram_dict *dict)
+{
+	return dict->nwords;
+}
+
+void
+anagram_dict_stats (const struct anagram_dict *dict, struct anagram_dict_stats *stats)
+{
+	*stats = dict->stats;
+}
+
+void
+anagram_dict_destroy (struct anagram_dict **dict)
+{
+	if (dict == NULL || *dict == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < (*dict)->nwords; i++) {
+		histogram_destroy(&(*dict)->words[i].hist);
+		free((char *) (*dict)->words[i].pub.str);
+	}
+
+	for (size_t i = 0; i < (*dict)->exclude.size; i++) {
+		free((char *) (*dict)->exclude.slots[i].str);
+	}
+
+	wordset_free(&(*dict)->exclude);
+	wordset_free(&(*dict)->unique);
+	trie_free(&(*dict)->trie);
+	histogram_destroy(&(*dict)->filter);
+	free((*dict)->words);
+	free(*dict);
+	*dict = NULL;
+}
+
+// Copy the included words into the query, and subtract them from the input.
+static bool
+query_include (struct anagram_query *q, const struct anagram_query_opts *opts)
+{
+	if (opts->ninclude == 0) {
+		return true;
+	}
+
+	if ((q->include = calloc(opts->ninclude, sizeof(*q->include))) == NULL) {
+		errno = ENOMEM;
+		return false;
+	}
+
+	for (size_t i = 0; i < opts->ninclude; i++) {
+		const char *str = opts->include[i];
+		size_t len = strlen(str);
+		struct histogram *h;
+		char *copy;
+		bool fits;
+
+		// Normalize the words like the dictionary words.
+		if (q->dict->normalize) {
+			trim(&str, &len);
+		}
+
+		// Skip empty words.
+		if (len == 0) {
+			continue;
+		}
+
+		if ((copy = word_copy(q->dict, str, len)) == NULL) {
+			errno = ENOMEM;
+			return false;
+		}
+
+		q->include[q->ninclude].str = copy;
+		q->include[q->ninclude].len = len;
+		q->ninclude++;
+
+		if (len >= q->opts.haslength) {
+			q->include_satisfied = true;
+		}
+
+		if ((h = histogram_create(copy, len)) == NULL) {
+			errno = ENOMEM;
+			return false;
+		}
+
+		// Fail if the word does not fit in what is left of the input.
+		fits = histogram_fits(h, q->hist) && histogram_subtract(q->hist, h);
+		histogram_destroy(&h);
+
+		if (!fits) {
+			errno = EINVAL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Bitset helpers.
+#define BIT_WORDS(n)		((n) / 64 + 1)
+#define BIT_SET(set, n)		((set)[(n) / 64] |= UINT64_C(1) << ((n) % 64))
+#define BIT_CLEAR(set, n)	((set)[(n) / 64] &= ~(UINT64_C(1) << ((n) % 64)))
+#define BIT_TEST(set, n)	(((set)[(n) / 64] >> ((n) % 64)) & 1)
+
+// Compute the bitmask of the bins of the query histogram which occur in a word.
+// Letters that the word takes from the wildcards have no bin.
+static uint64_t
+query_mask (const struct anagram_query *q, const struct word *w)
+{
+	uint64_t mask = 0;
+
+	for (size_t i = 0; i < w->hist->len; i++) {
+		const char *b = bsearch(&w->hist->bins[i], q->hist->bins, q->hist->len, 1, char_compare);
+
+		if (b != NULL) {
+			mask |= UINT64_C(1) << (b - q->hist->bins);
+		}
+	}
+
+	return mask;
+}
+
+struct anagram_query *
+anagram_query_create (const struct anagram_dict *dict, const char *str, size_t len, const struct anagram_query_opts *opts)
+{
+	struct anagram_query *q;
+	uint32_t h = FNV32_INIT;
+
+	if (dict == NULL || str == NULL || len == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (opts == NULL) {
+		opts = &anagram_query_opts_default;
+	}
+
+	if ((q = calloc(1, sizeof(*q))) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	q->dict = dict;
+	q->opts = *opts;
+	q->opts.include  = NULL;
+	q->opts.ninclude = 0;
+
+	if ((q->hist = histogram_create(str, len)) == NULL) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	if ((q->input = histogram_copy(q->hist)) == NULL) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	q->nletters = q->hist->ntotal;
+
+	if ((q->cand = malloc((dict->nwords + 1) * sizeof(*q->cand))) == NULL) {
+		errno = ENOMEM;
+		goto err;
+	}
+
+	// Subtract the included words from the input.
+	if (!query_include(q, opts)) {
+		goto err;
+	}
+
+	// Select the words from the dictionary which fit in the input.
+	for (size_t i = 0; i < dict->nwords; i++) {
+		const struct word *w = &dict->words[i];
+
+		if (w->pub.len < q->opts.minlength || w->pub.len > q->hist->ntotal) {
+			continue;
+		}
+
+		if (!histogram_fits(w->hist, q->hist)) {
+			continue;
+		}
+
+		if (w->pub.len > q->maxlen) {
+			q->maxlen = w->pub.len;
+		}
+
+		q->cand[q->ncand++] = i;
+	}
+
+	// Precompute which letters occur in each candidate, for the letter
+	// coverage check during the search.
+	if (q->hist->len <= 64) {
+		if ((q->masks = malloc((dict->nwords + 1) * sizeof(*q->masks))) == NULL) {
+			errno = ENOMEM;
+			goto err;
+		}
+
+		for (size_t i = 0; i < q->ncand; i++) {
+			q->masks[q->cand[i]] = query_mask(q, &dict->words[q->cand[i]]);
+		}
+	}
+
+	// Everything that determines the order of the results goes into the
+	// check value.
+	h = fnv32(h, &dict->checksum, sizeof(dict->checksum));
+	h = fnv32(h, q->hist->bins, q->hist->len);
+	h = fnv32(h, q->hist->freq, q->hist->len * sizeof(*q->hist->freq));
+	h = fnv32(h, &q->hist->nwild, sizeof(q->hist->nwild));
+	h = fnv32(h, &q->opts.minlength, sizeof(q->opts.minlength));
+	h = fnv32(h, &q->opts.haslength, sizeof(q->opts.haslength));
+	h = fnv32(h, &q->opts.partial, sizeof(q->opts.partial));
+	h = fnv32(h, &q->opts.minused, sizeof(q->opts.minused));
+	h = fnv32(h, &q->ncand, sizeof(q->ncand));
+	h = fnv32(h, q->cand, q->ncand * sizeof(*q->cand));
+
+	for (size_t i = 0; i < q->ninclude; i++) {
+		h = fnv32(h, q->include[i].str, q->include[i].len + 1);
+	}
+
+	q->check = h;
+	return q;
+
+err:	anagram_query_destroy(&q);
+	return NULL;
+}
+
+bool
+anagram_query_run (const struct anagram_query *q, anagram_result_fn fn, void *arg)
+{
+	struct anagram_cursor *c;
+	bool ret;
+
+	if ((c = anagram_cursor_create(q)) == NULL) {
+		return false;
+	}
+
+	ret = anagram_cursor_next(c, SIZE_MAX, fn, arg);
+	anagram_cursor_destroy(&c);
+	return ret;
+}
+
+void
+anagram_query_destroy (struct anagram_query **q)
+{
+	if (q == NULL || *q == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < (*q)->ninclude; i++) {
+		free((char *) (*q)->include[i].str);
+	}
+
+	free((*q)->include);
+	histogram_destroy(&(*q)->input);
+	histogram_destroy(&(*q)->hist);
+	free((*q)->cand);
+	free((*q)->masks);
+	free(*q);
+	*q = NULL;
+}
+
+size_t
+anagram_query_nwords (const struct anagram_query *q)
+{
+	return q->dict->nwords + q->ninclude;
+}
+
+const struct anagram_word *
+anagram_query_word (const struct anagram_query *q, size_t id)
+{
+	if (id < q->dict->nwords) {
+		return &q->dict->words[id].pub;
+	}
+
+	if (id - q->dict->nwords < q->ninclude) {
+		return &q->include[id - q->dict->nwords];
+	}
+
+	return NULL;
+}
+
+size_t
+anagram_query_word_id (const struct anagram_query *q, const struct anagram_word *word)
+{
+	const uintptr_t p = (uintptr_t) word;
+
+	// The included words are in an array of their own.
+	if (p >= (uintptr_t) q->include && p < (uintptr_t) (q->include + q->ninclude)) {
+		return q->dict->nwords + (size_t) (word - q->include);
+	}
+
+	// The public view is the first member of a dictionary word.
+	return (size_t) ((const struct word *) word - q->dict->words);
+}
+
+struct anagram_cursor *
+anagram_cursor_create (const struct anagram_query *q)
+{
+	const size_t ntotal = q->hist->ntotal;
+	struct anagram_cursor *c;
+
+	if ((c = calloc(1, sizeof(*c))) == NULL) {
+		return NULL;
+	}
+
+	c->query = q;
+
+	if ((c->frames = malloc((ntotal + 1) * sizeof(*c->frames))) == NULL) {
+		goto err;
+	}
+
+	if ((c->hists = calloc(ntotal + 1, sizeof(*c->hists))) == NULL) {
+		goto err;
+	}
+
+	for (size_t i = 0; i <= ntotal; i++) {
+		if ((c->hists[i] = histogram_copy(q->hist)) == NULL) {
+			goto err;
+		}
+	}
+
+	if ((c->stack = malloc((q->ninclude + ntotal + 1) * sizeof(*c->stack))) == NULL) {
+		goto err;
+	}
+
+	// The included words are at the bottom of the stack.
+	for (size_t i = 0; i < q->ninclude; i++) {
+		c->stack[i] = &q->include[i];
+	}
+
+	if ((c->leftover = calloc(ntotal + 1, 1)) == NULL) {
+		goto err;
+	}
+
+	if ((c->blanks = calloc(q->input->nwild + 1, 1)) == NULL) {
+		goto err;
+	}
+
+	if ((c->lenbits = calloc(BIT_WORDS(ntotal), sizeof(*c->lenbits))) == NULL) {
+		goto err;
+	}
+
+	if ((c->reach = calloc(BIT_WORDS(ntotal), sizeof(*c->reach))) == NULL) {
+		goto err;
+	}
+
+	if ((c->lens = malloc((ntotal + 1) * sizeof(*c->lens))) == NULL) {
+		goto err;
+	}
+
+	return c;
+
+err:	anagram_cursor_destroy(&c);
+	return NULL;
+}
+
+void
+anagram_cursor_destroy (struct anagram_cursor **c)
+{
+	if (c == NULL || *c == NULL) {
+		return;
+	}
+
+	if ((*c)->hists != NULL) {
+		for (size_t i = 0; i <= (*c)->query->hist->ntotal; i++) {
+			histogram_destroy(&(*c)->hists[i]);
+		}
+	}
+
+	free((*c)->hists);
+	free((*c)->frames);
+	free((*c)->found);
+	free((*c)->stack);
+	free((*c)->leftover);
+	free((*c)->blanks);
+	free((*c)->lenbits);
+	free((*c)->reach);
+	free((*c)->lens);
+	free(*c);
+	*c = NULL;
+}
+
+// Generate the words that fit by testing every candidate word.
+static size_t
+generate_list (const struct anagram_query *q, const struct histogram *h, uint32_t *out)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < q->ncand; i++) {
+		const struct word *w = &q->dict->words[q->cand[i]];
+
+		// Skip the word if it is longer than there are characters in
+		// the histogram, or if its histogram does not fit.
+		if (w->pub.len > h->ntotal || !histogram_fits(w->hist, h)) {
+			continue;
+		}
+
+		out[n++] = q->cand[i];
+	}
+
+	return n;
+}
+
+// Check whether the words that fit in a level can possibly use up all the
+// letters that are left. Every letter that is left must occur in at least one
+// of the words, and the number of letters left must be a sum of the lengths of
+// the words, each used any number of times.
+static bool
+cursor_feasible (struct anagram_cursor *c, const struct frame *f)
+{
+	const struct anagram_query *q = c->query;
+	const uint32_t *words = c->found + f->base;
+	const size_t ntotal = f->hist->ntotal;
+	uint64_t have = 0;
+	uint64_t need = 0;
+	size_t nlens = 0;
+
+	if (f->n == 0) {
+		return false;
+	}
+
+	// Collect the letters and the distinct lengths of the words.
+	for (size_t i = 0; i < f->n; i++) {
+		const size_t len = q->dict->words[words[i]].pub.len;
+
+		if (q->masks != NULL) {
+			have |= q->masks[words[i]];
+		}
+
+		if (!BIT_TEST(c->lenbits, len)) {
+			BIT_SET(c->lenbits, len);
+			c->lens[nlens++] = len;
+		}
+	}
+
+	for (size_t i = 0; i < nlens; i++) {
+		BIT_CLEAR(c->lenbits, c->lens[i]);
+	}
+
+	// Letter coverage.
+	if (q->masks != NULL) {
+		for (size_t i = 0; i < f->hist->len; i++) {
+			if (f->hist->freq[i] > 0) {
+				need |= UINT64_C(1) << i;
+			}
+		}
+
+		if (need & ~have) {
+			c->stats.pruned_letter++;
+			return false;
+		}
+	}
+
+	// Subset sum of the lengths, with repetition.
+	memset(c->reach, 0, BIT_WORDS(ntotal) * sizeof(*c->reach));
+	BIT_SET(c->reach, 0);
+
+	for (size_t sum = 1; sum <= ntotal; sum++) {
+		for (size_t i = 0; i < nlens; i++) {
+			if (c->lens[i] <= sum && BIT_TEST(c->reach, sum - c->lens[i])) {
+				BIT_SET(c->reach, sum);
+				break;
+			}
+		}
+	}
+
+	if (!BIT_TEST(c->reach, ntotal)) {
+		c->stats.pruned_length++;
+		return false;
+	}
+
+	return true;
+}
+
+// Push a new level for the histogram at the top of the stack. The level is
+// not pushed if it cannot lead to an anagram.
+static bool
+cursor_push (struct anagram_cursor *c, bool satisfied)
+{
+	const struct anagram_query *q = c->query;
+	struct frame *f = &c->frames[c->nframes];
+
+	// The words that fit are a subset of the candidates.
+	if (c->found_size - c->found_used < q->ncand) {
+		const size_t size = c->found_used + q->ncand;
+		uint32_t *found;
+
+		if ((found = realloc(c->found, size * sizeof(*found))) == NULL) {
+			return false;
+		}
+
+		c->found      = found;
+		c->found_size = size;
+	}
+
+	f->hist      = c->hists[c->nframes];
+	f->base      = c->found_used;
+	f->next      = 0;
+	f->satisfied = satisfied;
+
+	// Generate the words that fit; the anagram may contain the same word
+	// more than once.
+	if (q->opts.generator == ANAGRAM_GENERATOR_TRIE) {
+		f->n = trie_find(&q->dict->trie, f->hist, q->opts.minlength, c->found + f->base);
+	} else {
+		f->n = generate_list(q, f->hist, c->found + f->base);
+	}
+
+	c->stats.levels++;
+
+	// In partial mode, take the words of a set in dictionary order, so
+	// that each set is found once instead of once per permutation. The
+	// words that fit are in dictionary order, so drop those that come
+	// before the word taken at the level above. Any set of words that fits
+	// is a result, so the feasibility checks do not apply.
+	if (q->opts.partial) {
+		if (c->nframes > 0) {
+			const struct frame *up = &c->frames[c->nframes - 1];
+			const uint32_t min = c->found[up->base + up->next - 1];
+			uint32_t *words = c->found + f->base;
+			size_t skip = 0;
+
+			while (skip < f->n && words[skip] < min) {
+				skip++;
+			}
+
+			f->n -= skip;
+			memmove(words, words + skip, f->n * sizeof(*words));
+		}
+
+		if (f->n == 0) {
+			return true;
+		}
+
+	// Abandon the level before iterating over its words if it is doomed.
+	} else if (!cursor_feasible(c, f)) {
+		return true;
+	}
+
+	c->found_used += f->n;
+	c->nframes++;
+	return true;
+}
+
+// Take the next word at the top level. Subtracts it into the histogram of the
+// level below, and returns the word.
+static const struct word *
+cursor_take (struct anagram_cursor *c, bool *satisfied)
+{
+	const struct anagram_query *q = c->query;
+	const size_t depth = c->nframes - 1;
+	struct frame *f = &c->frames[depth];
+	const struct word *w = &q->dict->words[c->found[f->base + f->next++]];
+
+	*satisfied = f->satisfied || w->pub.len >= q->opts.haslength;
+
+	histogram_assign(c->hists[depth + 1], f->hist);
+	histogram_subtract(c->hists[depth + 1], w->hist);
+
+	c->stack[q->ninclude + depth] = &w->pub;
+	return w;
+}
+
+// Whether a level must be pushed for the histogram below the top level. If the
+// anagram must contain a word of a minimum length, which has not occurred so
+// far, and there are not enough letters left to create words of that length,
+// the branch is abandoned.
+static bool
+cursor_descend (const struct anagram_cursor *c, bool satisfied)
+{
+	const struct histogram *h = c->hists[c->nframes];
+
+	return h->ntotal > 0 && (satisfied || h->ntotal >= c->query->opts.haslength);
+}
+
+static bool
+cursor_start (struct anagram_cursor *c)
+{
+	const struct anagram_query *q = c->query;
+
+	c->started = true;
+	c->nframes = 0;
+	c->found_used = 0;
+
+	// Check that we have words, and that at least one of them has the
+	// required minimum length.
+	if (q->ncand == 0 || !(q->include_satisfied || q->maxlen >= q->opts.haslength)) {
+		c->done = true;
+		return true;
+	}
+
+	histogram_assign(c->hists[0], q->hist);
+
+	if (!cursor_descend(c, q->include_satisfied)) {
+		c->done = true;
+		return true;
+	}
+
+	return cursor_push(c, q->include_satisfied);
+}
+
+size_t
+result_blanks (const struct anagram_query *q, const struct anagram_word *const *words, size_t nwords, char *out)
+{
+	const struct histogram *in = q->input;
+	size_t n = 0;
+
+	if (in->nwild == 0) {
+		return 0;
+	}
+
+	int count[256] = { 0 };
+
+	// Start from minus the supply of each letter, so that every letter of
+	// the words which brings its count above zero came from a wildcard.
+	for (size_t i = 0; i < in->len; i++) {
+		count[(unsigned char) in->bins[i]] -= in->freq[i];
+	}
+
+	for (size_t i = 0; i < nwords; i++) {
+		for (size_t j = 0; j < words[i]->len; j++) {
+			const char c = words[i]->str[j];
+
+			if (c != HISTOGRAM_WILDCARD && ++count[(unsigned char) c] > 0) {
+				out[n++] = c;
+			}
+		}
+	}
+
+	// Insertion sort; there are only as many letters as wildcards.
+	for (size_t i = 1; i < n; i++) {
+		const char c = out[i];
+		size_t j = i;
+
+		for (; j > 0 && out[j - 1] > c; j--) {
+			out[j] = out[j - 1];
+		}
+
+		out[j] = c;
+	}
+
+	return n;
+}
+
+// Set the wildcard letters of a result.
+static void
+cursor_blanks (struct anagram_cursor *c, struct anagram_result *result)
+{
+	result->nblanks = result_blanks(c->query, result->words, result->nwords, c->blanks);
+	c->blanks[result->nblanks] = '\0';
+}
+
+bool
+anagram_cursor_next (struct anagram_cursor *c, size_t n, anagram_result_fn fn, void *arg)
+{
+	const struct anagram_query *q = c->query;
+	const size_t levels = c->stats.levels;
+	struct anagram_result result = {
+		.words    = c->stack,
+		.leftover = c->leftover,
+		.blanks   = c->blanks,
+	};
+
+	if (n == 0 || c->done) {
+		return true;
+	}
+
+	if (!c->started) {
+
+		// If the included words use up the whole input, they are the
+		// only anagram.
+		if (q->hist->ntotal == 0) {
+			c->started = c->done = true;
+
+			if (q->include_satisfied && q->nletters >= q->opts.minused) {
+				c->stats.results++;
+				result.nwords = q->ninclude;
+				cursor_blanks(c, &result);
+				fn(&result, arg);
+			}
+			return true;
+		}
+
+		if (!cursor_start(c)) {
+			return false;
+		}
+	}
+
+	while (n > 0 && c->nframes > 0) {
+		struct frame *f = &c->frames[c->nframes - 1];
+
+		// Return early when the limit is reached. Every state at the
+		// top of the loop can be saved and resumed.
+		if (c->limit > 0 && c->stats.levels - levels >= c->limit) {
+			break;
+		}
+
+		bool satisfied;
+
+		// Pop the level when all its words have been tried.
+		if (f->next == f->n) {
+			c->found_used = f->base;
+			c->nframes--;
+			continue;
+		}
+
+		cursor_take(c, &satisfied);
+
+		// In partial mode, every set of words that satisfies the
+		// requirements is a result. Descend before delivering the
+		// result, so that a paused search continues below it.
+		if (q->opts.partial) {
+			const struct histogram *h = c->hists[c->nframes];
+			const bool emit = satisfied && q->nletters - h->ntotal >= q->opts.minused;
+
+			if (emit) {
+				result.nwords    = q->ninclude + c->nframes;
+				result.nleftover = histogram_letters(h, c->leftover);
+				c->leftover[result.nleftover] = '\0';
+				cursor_blanks(c, &result);
+			}
+
+			if (cursor_descend(c, satisfied) && !cursor_push(c, satisfied)) {
+				return false;
+			}
+
+			if (emit) {
+				n--;
+				c->stats.results++;
+
+				if (!fn(&result, arg)) {
+					break;
+				}
+			}
+			continue;
+		}
+
+		// Empty histogram? Found an anagram. Other words may still fit,
+		// so keep looping.
+		if (c->hists[c->nframes]->ntotal == 0) {
+			if (satisfied) {
+				n--;
+				c->stats.results++;
+				result.nwords = q->ninclude + c->nframes;
+				cursor_blanks(c, &result);
+
+				// The callback can pause the search.
+				if (!fn(&result, arg)) {
+					break;
+				}
+			}
+			continue;
+		}
+
+		// Else descend.
+		if (cursor_descend(c, satisfied) && !cursor_push(c, satisfied)) {
+			return false;
+		}
+	}
+
+	if (c->nframes == 0) {
+		c->done = true;
+	}
+
+	return true;
+}
+
+void
+anagram_cursor_limit (struct anagram_cursor *c, size_t levels)
+{
+	c->limit = levels;
+}
+
+bool
+anagram_cursor_done (const struct anagram_cursor *c)
+{
+	return c->done;
+}
+
+void
+anagram_cursor_stats (const struct anagram_cursor *c, struct anagram_search_stats *stats)
+{
+	*stats = c->stats;
+}
+
+// Token format version.
+#define TOKEN_VERSION	1
+
+size_t
+anagram_cursor_save (const struct anagram_cursor *c, void *buf, size_t size)
+{
+	size_t pos = 0;
+
+	// Header: version, check value, state.
+	pos = varint_put(buf, size, pos, TOKEN_VERSION);
+	pos = varint_put(buf, size, pos, c->query->check);
+	pos = varint_put(buf, size, pos, c->done ? 2 : c->started ? 1 : 0);
+
+	// The position of the next word at each level. Below the top level,
+	// the word before that position is the one that was taken.
+	if (c->started && !c->done) {
+		pos = varint_put(buf, size, pos, c->nframes);
+
+		for (size_t i = 0; i < c->nframes; i++) {
+			pos = varint_put(buf, size, pos, c->frames[i].next);
+		}
+	}
+
+	return pos;
+}
+
+bool
+anagram_cursor_resume (struct anagram_cursor *c, const void *buf, size_t size)
+{
+	const struct anagram_query *q = c->query;
+	uint64_t version, check, state, nframes;
+	size_t pos = 0;
+
+	if (c->started
+	 || !varint_get(buf, size, &pos, &version) || version != TOKEN_VERSION
+	 || !varint_get(buf, size, &pos, &check)   || check != q->check
+	 || !varint_get(buf, size, &pos, &state)   || state > 2) {
+		errno = EINVAL;
+		return false;
+	}
+
+	// Not started yet, or finished. Nothing follows the header.
+	if (state != 1) {
+		if (pos != size) {
+			errno = EINVAL;
+			return false;
+		}
+
+		c->started = c->done = state == 2;
+		return true;
+	}
+
+	if (!varint_get(buf, size, &pos, &nframes) || nframes == 0 || nframes > q->hist->ntotal) {
+		errno = EINVAL;
+		return false;
+	}
+
+	if (!cursor_start(c)) {
+		errno = ENOMEM;
+		return false;
+	}
+
+	// Replay the search down to the saved level, checking at every step
+	// that the token describes a state the search can actually be in.
+	for (uint64_t i = 0; i < nframes; i++) {
+		struct frame *f;
+		uint64_t next;
+		bool satisfied;
+
+		if (c->nframes != i + 1 || !varint_get(buf, size, &pos, &next)) {
+			goto err;
+		}
+
+		f = &c->frames[i];
+
+		if (next > f->n) {
+			goto err;
+		}
+
+		// At the top level, just continue from the saved position.
+		if (i + 1 == nframes) {
+			f->next = next;
+			break;
+		}
+
+		// Below the top level, retake the word that was taken.
+		if (next == 0) {
+			goto err;
+		}
+
+		f->next = next - 1;
+		cursor_take(c, &satisfied);
+
+		if (!cursor_descend(c, satisfied)) {
+			goto err;
+		}
+
+		if (!cursor_push(c, satisfied)) {
+			errno = ENOMEM;
+			return false;
+		}
+	}
+
+	if (pos == size) {
+		return true;
+	}
+
+err:	c->started = false;
+	c->done    = false;
+	c->nframes = 0;
+	errno = EINVAL;
+	return false;
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Marks the symbols of the interface. The library is built with hidden
+// visibility, so that its internal functions do not clash with the symbols of
+// a program that embeds it.
+#if defined(__GNUC__)
+#define ANAGRAM_API	__attribute__((visibility("default")))
+#else
+#define ANAGRAM_API
+#endif
+
+// Opaque dictionary handle. A dictionary is filled once, after which it is
+// only ever read. A filled dictionary can be shared by any number of queries,
+// including queries running concurrently in different threads.
+struct anagram_dict;
+
+// Opaque per-query context. A query holds the input and the words which fit
+// in it. Once created it is only read, like the dictionary.
+struct anagram_query;
+
+// Opaque collection of words to be sorted into single-word anagram groups.
+struct anagram_groups;
+
+// Opaque handle to an on-disk cache of query results.
+struct anagram_cache;
+
+// Opaque cursor over the results of a query. A cursor holds all mutable
+// search state and must not be used by more than one thread at a time. Any
+// number of cursors can iterate over the same query.
+struct anagram_cursor;
+
+// A dictionary word as seen by the user of the library. The string is owned by
+// the dictionary and remains valid until the dictionary is destroyed.
+struct anagram_word {
+
+	// Pointer to the NUL-terminated word.
+	const char *str;
+
+	// Length of the word in bytes.
+	size_t len;
+};
+
+struct anagram_dict_opts {
+
+	// If not NULL, only keep words that fit inside the histogram of this
+	// string. Queries on the dictionary must use an input which is at
+	// least a superset of this string.
+	const char *filter;
+
+	// Length of #filter in bytes.
+	size_t filter_len;
+
+	// Normalize words before adding or excluding them: strip surrounding
+	// whitespace and convert ASCII letters to lowercase.
+	bool normalize;
+
+	// Drop words shorter than this length while loading, which saves the
+	// work of indexing them. Queries on the dictionary never see these
+	// words, whatever their own minimum length.
+	uint8_t minlength;
+};
+
+struct anagram_dict_stats {
+
+	// Number of words offered to the dictionary.
+	size_t offered;
+
+	// Number of words in the dictionary.
+	size_t words;
+
+	// Number of words dropped because they were already in the dictionary.
+	size_t duplicates;
+
+	// Number of words dropped because they were excluded.
+	size_t excluded;
+};
+
+// Ways to generate the words which fit in what is left of the input. The
+// default is the zero value, so that options built with a designated
+// initializer get it too.
+enum anagram_generator {
+
+	// Walk a trie of the letter-sorted words, skipping all words which
+	// share an impossible prefix with a single check.
+	ANAGRAM_GENERATOR_TRIE = 0,
+
+	// Test every candidate word in turn.
+	ANAGRAM_GENERATOR_LIST,
+};
+
+struct anagram_query_opts {
+
+	// All words in the anagram must have at least this length.
+	uint8_t minlength;
+
+	// The anagram must contain at least one word of this length.
+	uint8_t haslength;
+
+	// Array of words which every anagram must contain. These words are
+	// subtracted from the input before the search starts, and are added
+	// to every result. They need not be in the dictionary. If the
+	// dictionary normalizes its words, these words are normalized too.
+	const char *const *include;
+
+	// Number of words in #include.
+	size_t ninclude;
+
+	// Candidate word generator. Both generators find the same anagrams in
+	// the same order.
+	enum anagram_generator generator;
+
+	// Find sub-anagrams: every set of words which fits in the input, not
+	// only those which use up all letters. Each set is found once, not once
+	// for every order of its words. The included words alone do not count as
+	// a sub-anagram unless they use up all letters.
+	bool partial;
+
+	// In partial mode, the minimum number of letters of the input, including
+	// those of the included words, that a sub-anagram must use.
+	uint8_t minused;
+};
+
+struct anagram_result {
+
+	// Array of pointers to the words of this anagram, in the order in
+	// which they were found. The pointers point into the dictionary;
+	// nothing is copied.
+	const struct anagram_word *const *words;
+
+	// Number of words in #words.
+	size_t nwords;
+
+	// The letters of the input that are not used by the words, in sorted
+	// order. Always empty, except in partial mode.
+	const char *leftover;
+
+	// Number of letters in #leftover.
+	size_t nleftover;
+
+	// The letters which the wildcards of the input stand for, in sorted
+	// order. Always empty, unless the input contains wildcards. In partial
+	// mode, the wildcards that are not used are in #leftover.
+	const char *blanks;
+
+	// Number of letters in #blanks.
+	size_t nblanks;
+};
+
+struct anagram_search_stats {
+
+	// Number of search levels entered.
+	size_t levels;
+
+	// Number of levels abandoned because a letter that is left occurs in
+	// none of the words that fit.
+	size_t pruned_letter;
+
+	// Number of levels abandoned because no sum of the lengths of the words
+	// that fit equals the number of letters left.
+	size_t pruned_length;
+
+	// Number of results delivered.
+	size_t results;
+};
+
+struct anagram_groups_opts {
+
+	// Only report groups of at least this many distinct words.
+	size_t minsize;
+
+	// Number of threads that compute the word signatures, zero for one
+	// per online processor.
+	size_t nthreads;
+
+	// Normalize words before adding them, like the dictionary does.
+	bool normalize;
+};
+
+struct anagram_group {
+
+	// Array of pointers to the words of the group, which are all anagrams
+	// of each other, in the order in which they were added.
+	const struct anagram_word *const *words;
+
+	// Number of words in #words.
+	size_t nwords;
+};
+
+// Group callback. Called once for every group. The group is only valid for the
+// duration of the call. Return false to stop.
+typedef bool (*anagram_group_fn) (const struct anagram_group *group, void *arg);
+
+// Result callback. Called once for every anagram found. The result is only
+// valid for the duration of the call. Return false to stop the search.
+typedef bool (*anagram_result_fn) (const struct anagram_result *result, void *arg);
+
+// Default dictionary, query and group options.
+extern ANAGRAM_API const struct anagram_dict_opts   anagram_dict_opts_default;
+extern ANAGRAM_API const struct anagram_query_opts  anagram_query_opts_default;
+extern ANAGRAM_API const struct anagram_groups_opts anagram_groups_opts_default;
+
+// Create an empty dictionary. A NULL #opts selects the default options.
+extern ANAGRAM_API struct anagram_dict *anagram_dict_create (const struct anagram_dict_opts *opts);
+
+// Exclude a word from the dictionary. Excluded words are dropped when they are
+// added, so this must be called before adding words. Returns false on
+// allocation failure.
+extern ANAGRAM_API bool anagram_dict_exclude_word (struct anagram_dict *dict, const char *str, size_t len);
+
+// Exclude all words from a file with one word per line.
+extern ANAGRAM_API bool anagram_dict_exclude_file (struct anagram_dict *dict, const char *path);
+
+// Add a single word to the dictionary. Words that can never be part of an
+// anagram, words that contain wildcards, and words that are already in the
+// dictionary, are silently skipped.
+// Returns false on allocation failure, after which the dictionary can only be
+// destroyed.
+extern ANAGRAM_API bool anagram_dict_add_word (struct anagram_dict *dict, const char *str, size_t len);
+
+// Add all words from a file with one word per line to the dictionary.
+extern ANAGRAM_API bool anagram_dict_add_file (struct anagram_dict *dict, const char *path);
+
+// Number of words in the dictionary.
+extern ANAGRAM_API size_t anagram_dict_size (const struct anagram_dict *dict);
+
+// Get the dictionary load statistics.
+extern ANAGRAM_API void anagram_dict_stats (const struct anagram_dict *dict, struct anagram_dict_stats *stats);
+
+extern ANAGRAM_API void anagram_dict_destroy (struct anagram_dict **dict);
+
+// Create a query for the given input string against a dictionary. Every '?' in
+// the input is a wildcard, which stands for any one letter. A NULL #opts
+// selects the default options. Returns NULL and sets errno to EINVAL if the
+// included words do not fit in the input, or to ENOMEM on allocation failure.
+extern ANAGRAM_API struct anagram_query *anagram_query_create (const struct anagram_dict *dict, const char *str, size_t len, const struct anagram_query_opts *opts);
+
+// Run the query to completion, or until the callback returns false. Returns
+// false on allocation failure.
+extern ANAGRAM_API bool anagram_query_run (const struct anagram_query *query, anagram_result_fn fn, void *arg);
+
+extern ANAGRAM_API void anagram_query_destroy (struct anagram_query **query);
+
+// Number of word IDs of a query. The IDs of the dictionary words are their
+// indices in dictionary order, and the included words follow, in the order in
+// which they were given.
+extern ANAGRAM_API size_t anagram_query_nwords (const struct anagram_query *query);
+
+// Get the word with the given ID, or NULL if there is no such word.
+extern ANAGRAM_API const struct anagram_word *anagram_query_word (const struct anagram_query *query, size_t id);
+
+// Get the ID of a word in a result of the query.
+extern ANAGRAM_API size_t anagram_query_word_id (const struct anagram_query *query, const struct anagram_word *word);
+
+// Create a cursor positioned at the start of the results of a query. The query
+// must outlive the cursor.
+extern ANAGRAM_API struct anagram_cursor *anagram_cursor_create (const struct anagram_query *query);
+
+// Deliver at most #n more results to the callback. The search suspends after
+// the n-th result, or after a result for which the callback returns false,
+// and continues from there on the next call. Returns false on allocation
+// failure.
+extern ANAGRAM_API bool anagram_cursor_next (struct anagram_cursor *cursor, size_t n, anagram_result_fn fn, void *arg);
+
+// Limit every following call of anagram_cursor_next() to entering at most
+// #levels search levels, after which it returns early, possibly without having
+// delivered any results. This bounds the time spent in a call, for instance to
+// save the position of the cursor at regular intervals. Zero, the default,
+// means no limit.
+extern ANAGRAM_API void anagram_cursor_limit (struct anagram_cursor *cursor, size_t levels);
+
+// Whether all results have been delivered.
+extern ANAGRAM_API bool anagram_cursor_done (const struct anagram_cursor *cursor);
+
+// Get the search statistics of the cursor so far.
+extern ANAGRAM_API void anagram_cursor_stats (const struct anagram_cursor *cursor, struct anagram_search_stats *stats);
+
+// Serialize the position of the cursor into a compact resume token. Writes at
+// most #size bytes to #buf, and returns the full size of the token. If that is
+// larger than #size, the token was truncated; call with a NULL #buf and zero
+// #size to get the size.
+extern ANAGRAM_API size_t anagram_cursor_save (const struct anagram_cursor *cursor, void *buf, size_t size);
+
+// Restore a fresh cursor to the position saved in a resume token. The token
+// must have been saved by a cursor on an identical query. Returns false and
+// sets errno to EINVAL if the token is invalid, or to ENOMEM on allocation
+// failure.
+extern ANAGRAM_API bool anagram_cursor_resume (struct anagram_cursor *cursor, const void *buf, size_t size);
+
+extern ANAGRAM_API void anagram_cursor_destroy (struct anagram_cursor **cursor);
+
+// Open a result cache in the given directory, which is created if it does not
+// exist. The cache can be shared by any number of processes. When a new entry
+// brings the total size of the cache above #max_size bytes, the least recently
+// used entries are removed. Returns NULL on failure, with errno set.
+extern ANAGRAM_API struct anagram_cache *anagram_cache_open (const char *dir, uint64_t max_size);
+
+// Run a query to completion, or until the callback returns false, using the
+// cache. Results are cached by dictionary contents, canonical input and
+// options. On a hit the results are read from the cache, otherwise the search
+// is run and its results are stored if it completes. If not NULL, #hit is set
+// to whether the cache was hit, and #stats to the search statistics, of which
+// only the number of results is set on a hit. Returns false on allocation or
+// read failure.
+extern ANAGRAM_API bool anagram_cache_run (struct anagram_cache *cache, const struct anagram_query *query, anagram_result_fn fn, void *arg, bool *hit, struct anagram_search_stats *stats);
+
+extern ANAGRAM_API void anagram_cache_close (struct anagram_cache **cache);
+
+// Create an empty collection of words for group extraction. The words are
+// stored compactly, without the per-word search structures of a dictionary,
+// so that lists of millions of words fit in little memory. A NULL #opts
+// selects the default options.
+extern ANAGRAM_API struct anagram_groups *anagram_groups_create (const struct anagram_groups_opts *opts);
+
+// Add a single word. Returns false on allocation failure.
+extern ANAGRAM_API bool anagram_groups_add_word (struct anagram_groups *groups, const char *str, size_t len);
+
+// Add all words from a file with one word per line.
+extern ANAGRAM_API bool anagram_groups_add_file (struct anagram_groups *groups, const char *path);
+
+// Find all sets of words which are anagrams of each other, and deliver them to
+// the callback in the order in which their first words were added. Returns
+// false on allocation failure.
+extern ANAGRAM_API bool anagram_groups_run (struct anagram_groups *groups, anagram_group_fn fn, void *arg);
+
+extern ANAGRAM_API void anagram_groups_destroy (struct anagram_groups **groups);
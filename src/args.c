@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <getopt.h>
 
@@ -20,6 +21,56 @@ get_uint8 (uint8_t *dst)
 	return true;
 }
 
+// Parse a positive number of seconds.
+static bool
+get_seconds (unsigned int *dst)
+{
+	char *eptr;
+	const long l = strtol(optarg, &eptr, 10);
+
+	if (l <= 0 || l > 86400 * 365 || *eptr != '\0') {
+		return false;
+	}
+
+	*dst = (unsigned int) l;
+	return true;
+}
+
+// Parse a size in bytes, with an optional K, M or G suffix.
+static bool
+get_size (uint64_t *dst)
+{
+	char *eptr;
+	const unsigned long long l = strtoull(optarg, &eptr, 10);
+	int shift = 0;
+
+	switch (*eptr) {
+	case 'K': shift = 10; eptr++; break;
+	case 'M': shift = 20; eptr++; break;
+	case 'G': shift = 30; eptr++; break;
+	}
+
+	if (eptr == optarg || *optarg == '-' || *eptr != '\0' || l > (UINT64_MAX >> shift)) {
+		return false;
+	}
+
+	*dst = (uint64_t) l << shift;
+	return true;
+}
+
+// Append the current option argument to a list. The list is allocated on
+// first use, large enough to hold all arguments.
+static bool
+append (struct args *list, const struct args *args)
+{
+	if (list->av == NULL && (list->av = malloc(args->ac * sizeof(*list->av))) == NULL) {
+		return false;
+	}
+
+	list->av[list->ac++] = optarg;
+	return true;
+}
+
 bool
 args_parse (struct config *config, const struct args *args)
 {
@@ -29,6 +80,23 @@ args_parse (struct config *config, const struct args *args)
 		{ "dictfile",  required_argument, NULL, 'f' },
 		{ "minlength", required_argument, NULL, 'm' },
 		{ "haslength", required_argument, NULL, 'l' },
+		{ "include",   required_argument, NULL, 'i' },
+		{ "exclude",   required_argument, NULL, 'x' },
+		{ "exclude-file", required_argument, NULL, 'X' },
+		{ "partial",   no_argument,       NULL, 'p' },
+		{ "minused",   required_argument, NULL, 'u' },
+		{ "groups",    no_argument,       NULL, 'G' },
+		{ "min-group", required_argument, NULL, 'M' },
+		{ "cache-dir", required_argument, NULL, 'c' },
+		{ "cache-size", required_argument, NULL, 'C' },
+		{ "checkpoint", required_argument, NULL, 'k' },
+		{ "checkpoint-interval", required_argument, NULL, 'K' },
+		{ "resume",    required_argument, NULL, 'r' },
+		{ "output",    required_argument, NULL, 'o' },
+		{ "index-file", required_argument, NULL, 'O' },
+		{ "generator", required_argument, NULL, 'g' },
+		{ "normalize", no_argument,       NULL, 'n' },
+		{ "stats",     no_argument,       NULL, 's' },
 		{ NULL }
 	};
 
@@ -41,14 +109,24 @@ args_parse (struct config *config, const struct args *args)
 	config->name = args->av[0];
 
 	// Parse the command line options.
-	while ((c = getopt_long(args->ac, args->av, ":hf:m:l:", opts, NULL)) != -1) {
+	while ((c = getopt_long(args->ac, args->av, ":hf:m:l:i:x:X:pu:GM:c:C:k:K:r:o:O:g:ns", opts, NULL)) != -1) {
 		switch (c) {
 		case 'h':
 			config->print_help = true;
 			return true;
 
 		case 'f':
-			config->dictfile = optarg;
+			if (!append(&config->dictfiles, args)) {
+				return false;
+			}
+			break;
+
+		case 'n':
+			config->normalize = true;
+			break;
+
+		case 's':
+			config->print_stats = true;
 			break;
 
 		case 'm':
@@ -67,6 +145,108 @@ args_parse (struct config *config, const struct args *args)
 			}
 			break;
 
+		case 'i':
+			if (!append(&config->include, args)) {
+				return false;
+			}
+			break;
+
+		case 'x':
+			if (!append(&config->exclude, args)) {
+				return false;
+			}
+			break;
+
+		case 'X':
+			if (!append(&config->exclude_files, args)) {
+				return false;
+			}
+			break;
+
+		case 'p':
+			config->partial = true;
+			break;
+
+		case 'u':
+			if (!get_uint8(&config->minused)) {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
+		case 'G':
+			config->groups = true;
+			break;
+
+		case 'M':
+			if (!get_uint8(&config->mingroup)) {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
+		case 'c':
+			config->cache_dir = optarg;
+			break;
+
+		case 'C':
+			if (!get_size(&config->cache_size)) {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
+		case 'k':
+			config->checkpoint = optarg;
+			break;
+
+		case 'K':
+			if (!get_seconds(&config->checkpoint_interval)) {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
+		case 'r':
+			config->resume = optarg;
+			break;
+
+		case 'o':
+			if (strcmp(optarg, "text") == 0) {
+				config->output = OUTPUT_TEXT;
+			} else if (strcmp(optarg, "nul") == 0) {
+				config->output = OUTPUT_NUL;
+			} else if (strcmp(optarg, "ndjson") == 0) {
+				config->output = OUTPUT_NDJSON;
+			} else if (strcmp(optarg, "binary") == 0) {
+				config->output = OUTPUT_BINARY;
+			} else {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
+		case 'O':
+			config->index_file = optarg;
+			break;
+
+		case 'g':
+			if (strcmp(optarg, "list") == 0) {
+				config->generator = ANAGRAM_GENERATOR_LIST;
+			} else if (strcmp(optarg, "trie") == 0) {
+				config->generator = ANAGRAM_GENERATOR_TRIE;
+			} else {
+				fprintf(stderr, "%s: '%s': invalid value.\n",
+				        config->name, optarg);
+				return false;
+			}
+			break;
+
 		default:
 			if (optopt != 0) {
 				fprintf(stderr, "%s: '%c': unknown option.\n",
@@ -79,9 +259,32 @@ args_parse (struct config *config, const struct args *args)
 		}
 	}
 
+	// Results from the cache cannot be checkpointed.
+	if (config->cache_dir != NULL && (config->checkpoint != NULL || config->resume != NULL)) {
+		fprintf(stderr, "%s: the cache cannot be combined with checkpoints.\n",
+		        config->name);
+		return false;
+	}
+
+	// Groups are not made of dictionary words, so they have no word IDs.
+	if (config->groups && (config->output == OUTPUT_BINARY || config->index_file != NULL)) {
+		fprintf(stderr, "%s: groups have no word IDs.\n",
+		        config->name);
+		return false;
+	}
+
 	// The positional arguments are the words to anagram.
 	config->words.ac = args->ac - optind;
 	config->words.av = args->av + optind;
 
 	return true;
 }
+
+void
+args_free (struct config *config)
+{
+	free(config->dictfiles.av);
+	free(config->include.av);
+	free(config->exclude.av);
+	free(config->exclude_files.av);
+}
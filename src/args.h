@@ -16,3 +16,6 @@ struct args {
 
 // Parse the command line arguments, populate the config structure.
 extern bool args_parse (struct config *config, const struct args *args);
+
+// Free the argument lists allocated by args_parse().
+extern void args_free (struct config *config);
@@ -0,0 +1,679 @@
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+// A cache entry is a file named after the hash of its key, containing:
+//
+//   - the magic string CACHE_MAGIC;
+//   - the length of the key as a varint, followed by the key itself;
+//   - one record per result: the number of words shared with the previous
+//     result plus one, the number of new words, and the dictionary indices of
+//     the new words, all as varints;
+//   - a zero byte marking the end of the records;
+//   - the trailer: CACHE_TRAILER and the number of results as a 64-bit
+//     little-endian integer.
+//
+// Consecutive results of the depth-first search share most of their words, so
+// the records are typically only a few bytes each.
+#define CACHE_MAGIC	"ANAC1\n"
+#define CACHE_TRAILER	"ANAE"
+#define CACHE_SUFFIX	".anac"
+#define CACHE_TMP	".tmp."
+#define CACHE_LOCK	".lock"
+
+// Temporary files older than this many seconds were left behind by crashed
+// processes and can be removed.
+#define CACHE_TMP_AGE	3600
+
+struct anagram_cache {
+
+	// Path of the cache directory.
+	char *dir;
+
+	// Maximum total size of the cache entries in bytes.
+	uint64_t max_size;
+};
+
+// Growable byte buffer.
+struct buf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+};
+
+// State of a search whose results are written to a new cache entry.
+struct writer {
+
+	// The query and the user's callback.
+	const struct anagram_query *query;
+	anagram_result_fn fn;
+	void *arg;
+
+	// The temporary file being written, and the maximum size it may grow
+	// to before the entry is abandoned.
+	FILE *fp;
+	uint64_t max_size;
+
+	// Dictionary indices of the words of the previous result.
+	uint32_t *prev;
+	size_t nprev;
+
+	// Number of results written.
+	uint64_t count;
+
+	// Set when the entry cannot be completed, because of an error or
+	// because it grew too large.
+	bool failed;
+
+	// Set when the user's callback stopped the search.
+	bool stopped;
+};
+
+static bool
+buf_put (struct buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		const size_t size = (b->len + len) * 2;
+		uint8_t *p;
+
+		if ((p = realloc(b->data, size)) == NULL) {
+			return false;
+		}
+
+		b->data = p;
+		b->size = size;
+	}
+
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+	return true;
+}
+
+static bool
+buf_varint (struct buf *b, uint64_t v)
+{
+	uint8_t tmp[VARINT_MAX];
+
+	return buf_put(b, tmp, varint_put(tmp, sizeof(tmp), 0, v));
+}
+
+// Build the key of a query: everything that determines its results. The input
+// is represented by its canonical histogram, so that inputs which differ only
+// in letter order or spacing share an entry.
+static bool
+cache_key (const struct anagram_query *q, struct buf *key)
+{
+	const struct histogram *h = q->hist;
+	uint8_t checksum[8];
+	size_t nbins = 0;
+	bool ok = true;
+
+	for (int i = 0; i < 8; i++) {
+		checksum[i] = q->dict->checksum >> (i * 8);
+	}
+
+	for (size_t i = 0; i < h->len; i++) {
+		if (h->freq[i] > 0) {
+			nbins++;
+		}
+	}
+
+	ok = ok && buf_put(key, checksum, sizeof(checksum));
+	ok = ok && buf_varint(key, q->opts.minlength);
+	ok = ok && buf_varint(key, q->opts.haslength);
+	ok = ok && buf_varint(key, q->opts.partial);
+	ok = ok && buf_varint(key, q->opts.minused);
+	ok = ok && buf_varint(key, nbins);
+
+	for (size_t i = 0; ok && i < h->len; i++) {
+		if (h->freq[i] > 0) {
+			ok = buf_put(key, &h->bins[i], 1) && buf_varint(key, h->freq[i]);
+		}
+	}
+
+	ok = ok && buf_varint(key, h->nwild);
+
+	ok = ok && buf_varint(key, q->ninclude);
+
+	for (size_t i = 0; ok && i < q->ninclude; i++) {
+		ok = buf_varint(key, q->include[i].len)
+		  && buf_put(key, q->include[i].str, q->include[i].len);
+	}
+
+	return ok;
+}
+
+// Get the path of the entry for a key.
+static char *
+cache_path (const struct anagram_cache *cache, const struct buf *key)
+{
+	const uint64_t h = fnv64(FNV64_INIT, key->data, key->len);
+	char *path;
+	size_t len;
+
+	len = strlen(cache->dir) + 1 + 16 + sizeof(CACHE_SUFFIX);
+
+	if ((path = malloc(len)) == NULL) {
+		return NULL;
+	}
+
+	snprintf(path, len, "%s/%016" PRIx64 CACHE_SUFFIX, cache->dir, h);
+	return path;
+}
+
+struct anagram_cache *
+anagram_cache_open (const char *dir, uint64_t max_size)
+{
+	struct anagram_cache *cache;
+	struct stat st;
+
+	// Create the directory if it does not exist yet.
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+		return NULL;
+	}
+
+	if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		errno = ENOTDIR;
+		return NULL;
+	}
+
+	if ((cache = malloc(sizeof(*cache))) == NULL) {
+		return NULL;
+	}
+
+	if ((cache->dir = malloc(strlen(dir) + 1)) == NULL) {
+		free(cache);
+		return NULL;
+	}
+
+	strcpy(cache->dir, dir);
+	cache->max_size = max_size;
+	return cache;
+}
+
+void
+anagram_cache_close (struct anagram_cache **cache)
+{
+	if (cache == NULL || *cache == NULL) {
+		return;
+	}
+
+	free((*cache)->dir);
+	free(*cache);
+	*cache = NULL;
+}
+
+enum lookup {
+	LOOKUP_MISS,
+	LOOKUP_HIT,
+	LOOKUP_ERROR,
+};
+
+// Check that the entry is complete and belongs to the key. Returns the number
+// of results in #count and leaves the file positioned at the first record.
+static bool
+entry_check (FILE *fp, const struct buf *key, uint64_t *count)
+{
+	uint8_t trailer[sizeof(CACHE_TRAILER) - 1 + 8];
+	char magic[sizeof(CACHE_MAGIC) - 1];
+	uint64_t keylen;
+	long start;
+
+	if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0) {
+		return false;
+	}
+
+	if (!varint_read(fp, &keylen) || keylen != key->len) {
+		return false;
+	}
+
+	// Compare the full key, in case two keys hash to the same file name.
+	for (size_t i = 0; i < key->len; i++) {
+		if (getc(fp) != key->data[i]) {
+			return false;
+		}
+	}
+
+	if ((start = ftell(fp)) < 0) {
+		return false;
+	}
+
+	// Only complete entries have a trailer.
+	if (fseek(fp, -(long) sizeof(trailer), SEEK_END) != 0
+	 || fread(trailer, sizeof(trailer), 1, fp) != 1
+	 || memcmp(trailer, CACHE_TRAILER, sizeof(CACHE_TRAILER) - 1) != 0) {
+		return false;
+	}
+
+	*count = 0;
+	for (int i = 7; i >= 0; i--) {
+		*count = (*count << 8) | trailer[sizeof(CACHE_TRAILER) - 1 + i];
+	}
+
+	return fseek(fp, start, SEEK_SET) == 0;
+}
+
+// Stream the results of an entry to the callback.
+static enum lookup
+entry_read (const char *path, const struct anagram_query *q, const struct buf *key, anagram_result_fn fn, void *arg, struct anagram_search_stats *stats)
+{
+	const struct anagram_word **words;
+	enum lookup ret = LOOKUP_ERROR;
+	struct anagram_result result;
+	struct histogram *left = NULL;
+	char *leftover = NULL;
+	char *blanks = NULL;
+	size_t nwords = 0;
+	uint64_t count;
+	FILE *fp;
+
+	if ((fp = fopen(path, "rb")) == NULL) {
+		return LOOKUP_MISS;
+	}
+
+	if (!entry_check(fp, key, &count)) {
+		fclose(fp);
+		return LOOKUP_MISS;
+	}
+
+	// Mark the entry as recently used.
+	futimens(fileno(fp), NULL);
+
+	if ((words = malloc((q->ninclude + q->hist->ntotal + 1) * sizeof(*words))) == NULL) {
+		fclose(fp);
+		return LOOKUP_ERROR;
+	}
+
+	// In partial mode, the leftover letters are recomputed per result.
+	if (q->opts.partial) {
+		if ((left = histogram_copy(q->hist)) == NULL || (leftover = malloc(q->hist->ntotal + 1)) == NULL) {
+			goto out;
+		}
+	}
+
+	// The same goes for the letters which the wildcards stand for.
+	if ((blanks = malloc(q->input->nwild + 1)) == NULL) {
+		goto out;
+	}
+
+	// The included words are at the bottom of the stack.
+	for (size_t i = 0; i < q->ninclude; i++) {
+		words[i] = &q->include[i];
+	}
+
+	result.words     = words;
+	result.leftover  = "";
+	result.nleftover = 0;
+	result.blanks    = blanks;
+
+	for (uint64_t n = 0;; n++) {
+		uint64_t tag, nnew;
+
+		if (!varint_read(fp, &tag)) {
+			break;
+		}
+
+		// End of the records.
+		if (tag == 0) {
+			ret = n == count ? LOOKUP_HIT : LOOKUP_ERROR;
+			break;
+		}
+
+		// Keep the shared words, and read the new ones.
+		if (tag - 1 > nwords || !varint_read(fp, &nnew) || tag - 1 + nnew > q->hist->ntotal) {
+			break;
+		}
+
+		nwords = tag - 1;
+
+		while (nnew-- > 0) {
+			uint64_t index;
+
+			if (!varint_read(fp, &index) || index >= q->dict->nwords) {
+				goto out;
+			}
+
+			words[q->ninclude + nwords++] = &q->dict->words[index].pub;
+		}
+
+		if (stats != NULL) {
+			stats->results++;
+		}
+
+		result.nwords = q->ninclude + nwords;
+
+		if (left != NULL) {
+			histogram_assign(left, q->hist);
+
+			for (size_t i = 0; i < nwords; i++) {
+				const struct word *w = (const struct word *) words[q->ninclude + i];
+
+				if (!histogram_subtract(left, w->hist)) {
+					goto out;
+				}
+			}
+
+			result.nleftover = histogram_letters(left, leftover);
+			leftover[result.nleftover] = '\0';
+			result.leftover = leftover;
+		}
+
+		result.nblanks = result_blanks(q, words, result.nwords, blanks);
+		blanks[result.nblanks] = '\0';
+
+		if (!fn(&result, arg)) {
+			ret = LOOKUP_HIT;
+			break;
+		}
+	}
+
+out:	histogram_destroy(&left);
+	free(leftover);
+	free(blanks);
+	free(words);
+	fclose(fp);
+	return ret;
+}
+
+// Write a record for a result to the new entry, then pass the result on to the
+// user's callback.
+static bool
+writer_result (const struct anagram_result *result, void *arg)
+{
+	struct writer *w = arg;
+	const size_t ninclude = w->query->ninclude;
+	const size_t n = result->nwords - ninclude;
+	size_t shared = 0;
+
+	if (!w->failed) {
+		const struct word *words = w->query->dict->words;
+
+		// Included words are implied by the key; convert the rest to
+		// dictionary indices.
+		while (shared < n && shared < w->nprev
+		    && (const struct word *) result->words[ninclude + shared] == &words[w->prev[shared]]) {
+			shared++;
+		}
+
+		w->failed = !varint_write(w->fp, shared + 1) || !varint_write(w->fp, n - shared);
+
+		for (size_t i = shared; i < n && !w->failed; i++) {
+			w->prev[i] = (const struct word *) result->words[ninclude + i] - words;
+			w->failed = !varint_write(w->fp, w->prev[i]);
+		}
+
+		w->nprev = n;
+		w->count++;
+
+		// Abandon entries that would not fit in the cache anyway.
+		if ((uint64_t) ftell(w->fp) > w->max_size) {
+			w->failed = true;
+		}
+	}
+
+	if (!w->fn(result, w->arg)) {
+		w->stopped = true;
+		return false;
+	}
+
+	return true;
+}
+
+// Remove the oldest entries until the total size is within bounds. Only one
+// process at a time evicts; others skip eviction while the lock is held.
+static void
+cache_evict (const struct anagram_cache *cache)
+{
+	struct entry {
+		char *name;
+		off_t size;
+		struct timespec mtime;
+	} *entries = NULL;
+	size_t nentries = 0;
+	size_t size = 0;
+	uint64_t total = 0;
+	struct flock lock = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+	char path[4096];
+	struct dirent *de;
+	time_t now = time(NULL);
+	DIR *dir;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/" CACHE_LOCK, cache->dir);
+
+	if ((fd = open(path, O_RDWR | O_CREAT, 0666)) < 0) {
+		return;
+	}
+
+	if (fcntl(fd, F_SETLK, &lock) != 0) {
+		close(fd);
+		return;
+	}
+
+	if ((dir = opendir(cache->dir)) == NULL) {
+		close(fd);
+		return;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		const size_t len = strlen(de->d_name);
+		const bool tmp = strncmp(de->d_name, CACHE_TMP, sizeof(CACHE_TMP) - 1) == 0;
+		struct stat st;
+
+		if (!tmp && (len < sizeof(CACHE_SUFFIX) || strcmp(de->d_name + len - sizeof(CACHE_SUFFIX) + 1, CACHE_SUFFIX) != 0)) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", cache->dir, de->d_name);
+
+		if (stat(path, &st) != 0) {
+			continue;
+		}
+
+		// Remove temporary files left behind by crashed processes.
+		if (tmp) {
+			if (now - st.st_mtime > CACHE_TMP_AGE) {
+				unlink(path);
+			}
+			continue;
+		}
+
+		if (nentries == size) {
+			struct entry *e;
+
+			size = size ? size * 2 : 64;
+
+			if ((e = realloc(entries, size * sizeof(*e))) == NULL) {
+				goto out;
+			}
+
+			entries = e;
+		}
+
+		if ((entries[nentries].name = malloc(len + 1)) == NULL) {
+			goto out;
+		}
+
+		strcpy(entries[nentries].name, de->d_name);
+		entries[nentries].size  = st.st_size;
+		entries[nentries].mtime = st.st_mtim;
+		total += st.st_size;
+		nentries++;
+	}
+
+	// Remove the least recently used entries first. This is a selection
+	// rather than a full sort, as usually only a few entries go.
+	while (total > cache->max_size && nentries > 0) {
+		size_t oldest = 0;
+
+		for (size_t i = 1; i < nentries; i++) {
+			const struct timespec *a = &entries[i].mtime;
+			const struct timespec *b = &entries[oldest].mtime;
+
+			if (a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec)) {
+				oldest = i;
+			}
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[oldest].name);
+		unlink(path);
+		total -= entries[oldest].size;
+
+		free(entries[oldest].name);
+		entries[oldest] = entries[--nentries];
+	}
+
+out:	for (size_t i = 0; i < nentries; i++) {
+		free(entries[i].name);
+	}
+
+	free(entries);
+	closedir(dir);
+	close(fd);
+}
+
+// Run the search and store the results in a new entry. The entry is written
+// to a temporary file which is renamed into place when complete, so that
+// concurrent readers only ever see complete entries.
+static bool
+entry_write (const struct anagram_cache *cache, const char *path, const struct anagram_query *q, const struct buf *key, anagram_result_fn fn, void *arg, struct anagram_search_stats *stats)
+{
+	struct writer w = {
+		.query    = q,
+		.fn       = fn,
+		.arg      = arg,
+		.max_size = cache->max_size,
+	};
+	struct anagram_cursor *c;
+	char *tmp;
+	bool ret;
+	int fd;
+
+	if ((c = anagram_cursor_create(q)) == NULL) {
+		return false;
+	}
+
+	if ((tmp = malloc(strlen(cache->dir) + sizeof("/" CACHE_TMP "XXXXXX"))) == NULL) {
+		anagram_cursor_destroy(&c);
+		return false;
+	}
+
+	if ((w.prev = malloc((q->hist->ntotal + 1) * sizeof(*w.prev))) == NULL) {
+		anagram_cursor_destroy(&c);
+		free(tmp);
+		return false;
+	}
+
+	sprintf(tmp, "%s/" CACHE_TMP "XXXXXX", cache->dir);
+
+	// If the entry cannot be created, just run the search.
+	if ((fd = mkstemp(tmp)) < 0 || (w.fp = fdopen(fd, "wb")) == NULL) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp);
+		}
+		w.failed = true;
+	} else {
+		w.failed = fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1, 1, w.fp) != 1
+		        || !varint_write(w.fp, key->len)
+		        || fwrite(key->data, key->len, 1, w.fp) != 1;
+	}
+
+	ret = anagram_cursor_next(c, SIZE_MAX, writer_result, &w);
+
+	if (stats != NULL) {
+		anagram_cursor_stats(c, stats);
+	}
+
+	if (w.fp != NULL) {
+		uint8_t trailer[sizeof(CACHE_TRAILER) - 1 + 8];
+
+		memcpy(trailer, CACHE_TRAILER, sizeof(CACHE_TRAILER) - 1);
+
+		for (int i = 0; i < 8; i++) {
+			trailer[sizeof(CACHE_TRAILER) - 1 + i] = w.count >> (i * 8);
+		}
+
+		// Only complete searches are stored.
+		bool keep = ret && !w.failed && !w.stopped
+		         && putc(0, w.fp) != EOF
+		         && fwrite(trailer, sizeof(trailer), 1, w.fp) == 1
+		         && fflush(w.fp) == 0
+		         && fsync(fileno(w.fp)) == 0;
+
+		// Close the stream exactly once, whatever happened.
+		if (fclose(w.fp) != 0) {
+			keep = false;
+		}
+
+		w.fp = NULL;
+
+		if (keep && rename(tmp, path) == 0) {
+			cache_evict(cache);
+		} else {
+			unlink(tmp);
+		}
+	}
+
+	anagram_cursor_destroy(&c);
+	free(w.prev);
+	free(tmp);
+	return ret;
+}
+
+bool
+anagram_cache_run (struct anagram_cache *cache, const struct anagram_query *q, anagram_result_fn fn, void *arg, bool *hit, struct anagram_search_stats *stats)
+{
+	struct buf key = { NULL, 0, 0 };
+	bool ret = false;
+	char *path;
+
+	if (hit != NULL) {
+		*hit = false;
+	}
+
+	if (stats != NULL) {
+		memset(stats, 0, sizeof(*stats));
+	}
+
+	if (!cache_key(q, &key)) {
+		return false;
+	}
+
+	if ((path = cache_path(cache, &key)) == NULL) {
+		free(key.data);
+		return false;
+	}
+
+	switch (entry_read(path, q, &key, fn, arg, stats)) {
+	case LOOKUP_HIT:
+		if (hit != NULL) {
+			*hit = true;
+		}
+		ret = true;
+		break;
+
+	case LOOKUP_MISS:
+		ret = entry_write(cache, path, q, &key, fn, arg, stats);
+		break;
+
+	case LOOKUP_ERROR:
+		errno = EIO;
+		break;
+	}
+
+	free(path);
+	free(key.data);
+	return ret;
+}
@@ -0,0 +1,189 @@
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+// A checkpoint file holds the magic string, the size of the output at the time
+// of the checkpoint as a 64-bit little-endian integer, and the resume token of
+// the cursor, which takes up the rest of the file.
+#define CHECKPOINT_MAGIC	"ANCK1\n"
+#define CHECKPOINT_HEADER	(sizeof(CHECKPOINT_MAGIC) - 1 + 8)
+
+// Output size stored if the output is not a regular file.
+#define OFFSET_UNKNOWN		UINT64_MAX
+
+// Get the size of the output so far, if it is a regular file.
+static uint64_t
+output_offset (FILE *out)
+{
+	struct stat st;
+	off_t off;
+
+	if (fstat(fileno(out), &st) != 0 || !S_ISREG(st.st_mode)) {
+		return OFFSET_UNKNOWN;
+	}
+
+	if ((off = ftello(out)) < 0) {
+		return OFFSET_UNKNOWN;
+	}
+
+	return off;
+}
+
+// Sync the directory holding a file, so that a rename in it is durable.
+static void
+sync_dir (const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *dir;
+	int fd;
+
+	if (slash == NULL) {
+		dir = strdup(".");
+	} else if ((dir = malloc(slash - path + 2)) != NULL) {
+		memcpy(dir, path, slash - path + 1);
+		dir[slash - path + 1] = '\0';
+	}
+
+	if (dir == NULL) {
+		return;
+	}
+
+	if ((fd = open(dir, O_RDONLY)) >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+
+	free(dir);
+}
+
+bool
+checkpoint_save (const char *path, const struct anagram_cursor *cursor, FILE *out)
+{
+	const size_t size = anagram_cursor_save(cursor, NULL, 0);
+	uint8_t header[CHECKPOINT_HEADER];
+	uint64_t offset;
+	uint8_t *token;
+	bool ret = false;
+	char *tmp;
+	FILE *fp;
+
+	// All output up to the checkpoint must be on disk before it.
+	if (fflush(out) != 0) {
+		return false;
+	}
+
+	if ((offset = output_offset(out)) != OFFSET_UNKNOWN && fsync(fileno(out)) != 0) {
+		return false;
+	}
+
+	if ((token = malloc(size)) == NULL) {
+		return false;
+	}
+
+	if ((tmp = malloc(strlen(path) + sizeof(".tmp"))) == NULL) {
+		goto err_0;
+	}
+
+	anagram_cursor_save(cursor, token, size);
+	sprintf(tmp, "%s.tmp", path);
+
+	memcpy(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1);
+
+	for (int i = 0; i < 8; i++) {
+		header[sizeof(CHECKPOINT_MAGIC) - 1 + i] = offset >> (i * 8);
+	}
+
+	// Write to a temporary file, and rename it over the old checkpoint.
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		goto err_1;
+	}
+
+	ret = fwrite(header, sizeof(header), 1, fp) == 1
+	   && fwrite(token, size, 1, fp) == 1
+	   && fflush(fp) == 0
+	   && fsync(fileno(fp)) == 0;
+
+	if (fclose(fp) != 0) {
+		ret = false;
+	}
+
+	if (ret && rename(tmp, path) == 0) {
+		sync_dir(path);
+	} else {
+		unlink(tmp);
+		ret = false;
+	}
+
+err_1:	free(tmp);
+err_0:	free(token);
+	return ret;
+}
+
+bool
+checkpoint_load (const char *path, struct anagram_cursor *cursor, FILE *out)
+{
+	uint64_t offset = 0;
+	uint8_t *buf;
+	bool ret = false;
+	struct stat st;
+	long size;
+	FILE *fp;
+
+	if ((fp = fopen(path, "rb")) == NULL) {
+		return false;
+	}
+
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+		fclose(fp);
+		return false;
+	}
+
+	if ((buf = malloc(size + 1)) == NULL) {
+		fclose(fp);
+		return false;
+	}
+
+	if (fread(buf, 1, size, fp) != (size_t) size) {
+		goto out;
+	}
+
+	if ((size_t) size < CHECKPOINT_HEADER || memcmp(buf, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1) != 0) {
+		errno = EINVAL;
+		goto out;
+	}
+
+	for (int i = 7; i >= 0; i--) {
+		offset = (offset << 8) | buf[sizeof(CHECKPOINT_MAGIC) - 1 + i];
+	}
+
+	if (!anagram_cursor_resume(cursor, buf + CHECKPOINT_HEADER, size - CHECKPOINT_HEADER)) {
+		goto out;
+	}
+
+	// Drop the output written after the checkpoint. The output must still
+	// hold everything written before it.
+	if (offset != OFFSET_UNKNOWN && fstat(fileno(out), &st) == 0 && S_ISREG(st.st_mode)) {
+		if ((uint64_t) st.st_size < offset) {
+			errno = EINVAL;
+			goto out;
+		}
+
+		if (fflush(out) != 0 || ftruncate(fileno(out), offset) != 0 || fseeko(out, offset, SEEK_SET) != 0) {
+			goto out;
+		}
+	}
+
+	ret = true;
+
+out:	free(buf);
+	fclose(fp);
+	return ret;
+}
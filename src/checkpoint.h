@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "anagram.h"
+
+// Save the position of the cursor to a checkpoint file, together with the size
+// of the output so far. The output is flushed and synced first, so that the
+// checkpoint never refers to output which was lost. The file is replaced
+// atomically, so a crash leaves either the old or the new checkpoint.
+extern bool checkpoint_save (const char *path, const struct anagram_cursor *cursor, FILE *out);
+
+// Restore a fresh cursor from a checkpoint file. If the output is a regular
+// file, it is truncated to its size at the time of the checkpoint, so that no
+// output is repeated. Returns false and sets errno to EINVAL if the checkpoint
+// is invalid, belongs to a different query, or does not match the output.
+extern bool checkpoint_load (const char *path, struct anagram_cursor *cursor, FILE *out);
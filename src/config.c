@@ -6,5 +6,19 @@ const struct config config_default = {
 	.dictfile   = "/usr/share/dict/words",
 	.minlength  = 1,
 	.haslength  = 1,
+	.groups     = false,
+	.mingroup   = 2,
+	.cache_dir  = NULL,
+	.cache_size = 64 << 20,
+	.partial    = false,
+	.minused    = 1,
+	.checkpoint = NULL,
+	.checkpoint_interval = 60,
+	.resume     = NULL,
+	.output     = OUTPUT_TEXT,
+	.index_file = NULL,
+	.generator  = ANAGRAM_GENERATOR_TRIE,
+	.normalize  = false,
+	.print_stats = false,
 	.print_help = false,
 };
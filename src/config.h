@@ -3,25 +3,77 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "anagram.h"
 #include "args.h"
+#include "output.h"
 
 struct config {
 
 	// Name by which the binary was called.
 	const char *name;
 
-	// Path of the dictionary file to use.
+	// Path of the dictionary file to use if none are given.
 	const char *dictfile;
 
+	// Paths of the dictionary files given on the command line.
+	struct args dictfiles;
+
 	// Words given on the command line.
 	struct args words;
 
+	// Words which every anagram must contain.
+	struct args include;
+
+	// Words to drop from the dictionary.
+	struct args exclude;
+
+	// Files with words to drop from the dictionary.
+	struct args exclude_files;
+
 	// All words in the anagram must have at least this length.
 	uint8_t minlength;
 
 	// The anagram must contain at least one word of this length.
 	uint8_t haslength;
 
+	// Whether to list the single-word anagram groups of the dictionary
+	// instead of searching, and the minimum number of words in a group.
+	bool groups;
+	uint8_t mingroup;
+
+	// Directory of the result cache, NULL if not caching.
+	const char *cache_dir;
+
+	// Maximum size of the result cache in bytes.
+	uint64_t cache_size;
+
+	// Whether to find sub-anagrams, and the minimum number of letters they
+	// must use.
+	bool partial;
+	uint8_t minused;
+
+	// Path of the checkpoint file to save progress to, NULL if none, and
+	// the number of seconds between checkpoints.
+	const char *checkpoint;
+	unsigned int checkpoint_interval;
+
+	// Path of the checkpoint file to resume from, NULL if none.
+	const char *resume;
+
+	// Output format, and path of the file to write the table of word IDs
+	// to, NULL if none.
+	enum output_format output;
+	const char *index_file;
+
+	// Candidate word generator used by the search.
+	enum anagram_generator generator;
+
+	// Whether to normalize dictionary words and the input.
+	bool normalize;
+
+	// Whether to print statistics to standard error.
+	bool print_stats;
+
 	// Whether the user requested the help message.
 	bool print_help;
 };
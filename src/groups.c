@@ -0,0 +1,519 @@
+#define _XOPEN_SOURCE 700
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+// Below this number of words, the signatures are computed without threads.
+#define GROUPS_PARALLEL	65536
+
+// Number of bits sorted per pass of the radix sort. Must divide 64 into an
+// even number of passes.
+#define RADIX_BITS	16
+#define RADIX_SIZE	(1 << RADIX_BITS)
+
+struct gword {
+
+	// Hash of the canonical signature of the word: its histogram.
+	uint64_t sig;
+
+	// Offset of the word in the arena, and its length.
+	uint32_t off;
+	uint32_t len;
+};
+
+struct anagram_groups {
+
+	// Group options.
+	struct anagram_groups_opts opts;
+
+	// All words back to back, each NUL-terminated.
+	char *arena;
+	size_t arena_used;
+	size_t arena_size;
+
+	// Array of words, and number of words in use and allocated.
+	struct gword *words;
+	size_t nwords;
+	size_t words_size;
+
+	// Length of the longest word.
+	size_t maxlen;
+};
+
+// A range of the sorted words with the same signature hash.
+struct run {
+
+	// Offset of the first word of the run in the arena.
+	uint32_t first;
+
+	// Index of the first word in the sorted array, and number of words.
+	size_t start;
+	size_t len;
+};
+
+// The signatures of a range of the words, computed by one thread.
+struct job {
+	struct anagram_groups *groups;
+	size_t start;
+	size_t end;
+	pthread_t thread;
+	bool threaded;
+	bool ok;
+};
+
+const struct anagram_groups_opts anagram_groups_opts_default = {
+	.minsize   = 2,
+	.nthreads  = 0,
+	.normalize = false,
+};
+
+struct anagram_groups *
+anagram_groups_create (const struct anagram_groups_opts *opts)
+{
+	struct anagram_groups *g;
+
+	if ((g = calloc(1, sizeof(*g))) == NULL) {
+		return NULL;
+	}
+
+	g->opts = opts == NULL ? anagram_groups_opts_default : *opts;
+	return g;
+}
+
+void
+anagram_groups_destroy (struct anagram_groups **g)
+{
+	if (g == NULL || *g == NULL) {
+		return;
+	}
+
+	free((*g)->arena);
+	free((*g)->words);
+	free(*g);
+	*g = NULL;
+}
+
+bool
+anagram_groups_add_word (struct anagram_groups *g, const char *str, size_t len)
+{
+	struct gword *w;
+
+	if (g->opts.normalize) {
+		trim(&str, &len);
+	}
+
+	if (len == 0) {
+		return true;
+	}
+
+	// Offsets and lengths are 32-bit to keep the words small.
+	if (g->arena_used + len + 1 > UINT32_MAX) {
+		errno = EFBIG;
+		return false;
+	}
+
+	if (g->arena_used + len + 1 > g->arena_size) {
+		const size_t size = g->arena_size ? g->arena_size * 2 : 1 << 16;
+		char *arena;
+
+		if ((arena = realloc(g->arena, size > UINT32_MAX ? UINT32_MAX : size)) == NULL) {
+			return false;
+		}
+
+		g->arena      = arena;
+		g->arena_size = size > UINT32_MAX ? UINT32_MAX : size;
+	}
+
+	if (g->nwords == g->words_size) {
+		const size_t size = g->words_size ? g->words_size * 2 : 1024;
+		struct gword *words;
+
+		if ((words = realloc(g->words, size * sizeof(*words))) == NULL) {
+			return false;
+		}
+
+		g->words      = words;
+		g->words_size = size;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		g->arena[g->arena_used + i] = g->opts.normalize ? tolower((unsigned char) str[i]) : str[i];
+	}
+
+	g->arena[g->arena_used + len] = '\0';
+
+	w = &g->words[g->nwords++];
+	w->sig = 0;
+	w->off = g->arena_used;
+	w->len = len;
+
+	g->arena_used += len + 1;
+
+	if (len > g->maxlen) {
+		g->maxlen = len;
+	}
+
+	return true;
+}
+
+static bool
+groups_add_line (void *g, const char *line, size_t len)
+{
+	return anagram_groups_add_word(g, line, len);
+}
+
+bool
+anagram_groups_add_file (struct anagram_groups *g, const char *path)
+{
+	return read_lines(path, groups_add_line, g);
+}
+
+// Allocate a histogram with room for the longest word.
+static bool
+scratch_init (struct histogram *h, size_t maxlen)
+{
+	if ((h->bins = malloc(maxlen)) == NULL) {
+		return false;
+	}
+
+	if ((h->freq = malloc(maxlen * sizeof(*h->freq))) == NULL) {
+		free(h->bins);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+scratch_free (struct histogram *h)
+{
+	free(h->bins);
+	free(h->freq);
+}
+
+// FNV-1a hash of the bins and frequencies of a histogram.
+static uint64_t
+signature (const struct histogram *h)
+{
+	uint64_t sig = FNV64_INIT;
+
+	for (size_t i = 0; i < h->len; i++) {
+		sig = fnv64(sig, &h->bins[i], 1);
+		sig = fnv64(sig, &h->freq[i], sizeof(h->freq[i]));
+	}
+
+	return sig;
+}
+
+static void *
+job_run (void *arg)
+{
+	struct job *job = arg;
+	struct anagram_groups *g = job->groups;
+	struct histogram h;
+
+	if (!(job->ok = scratch_init(&h, g->maxlen))) {
+		return NULL;
+	}
+
+	for (size_t i = job->start; i < job->end; i++) {
+		struct gword *w = &g->words[i];
+
+		histogram_fill(&h, g->arena + w->off, w->len);
+		w->sig = signature(&h);
+	}
+
+	scratch_free(&h);
+	return NULL;
+}
+
+// Compute the signatures of all words, spread over a number of threads.
+static bool
+groups_sign (struct anagram_groups *g)
+{
+	size_t nthreads = g->opts.nthreads;
+	struct job *jobs;
+	bool ret = true;
+
+	if (nthreads == 0) {
+		const long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nthreads = n > 0 ? (size_t) n : 1;
+	}
+
+	if (g->nwords < GROUPS_PARALLEL) {
+		nthreads = 1;
+	}
+
+	if ((jobs = malloc(nthreads * sizeof(*jobs))) == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < nthreads; i++) {
+		jobs[i].groups = g;
+		jobs[i].start  = g->nwords * i / nthreads;
+		jobs[i].end    = g->nwords * (i + 1) / nthreads;
+		jobs[i].threaded = false;
+	}
+
+	// The calling thread takes the first job, and any job for which no
+	// thread could be started.
+	for (size_t i = 1; i < nthreads; i++) {
+		jobs[i].threaded = pthread_create(&jobs[i].thread, NULL, job_run, &jobs[i]) == 0;
+	}
+
+	for (size_t i = 0; i < nthreads; i++) {
+		if (!jobs[i].threaded) {
+			job_run(&jobs[i]);
+		}
+	}
+
+	for (size_t i = 0; i < nthreads; i++) {
+		if (jobs[i].threaded) {
+			pthread_join(jobs[i].thread, NULL);
+		}
+		ret = ret && jobs[i].ok;
+	}
+
+	free(jobs);
+	return ret;
+}
+
+// Sort the words by signature with a least significant digit radix sort. The
+// sort is stable, so words with the same signature stay in the order in which
+// they were added. This is much faster than qsort() on millions of words.
+static bool
+groups_sort (struct anagram_groups *g)
+{
+	struct gword *tmp, *src = g->words, *dst;
+	size_t *count;
+
+	if ((count = malloc(RADIX_SIZE * sizeof(*count))) == NULL) {
+		return false;
+	}
+
+	if ((tmp = malloc(g->nwords * sizeof(*tmp))) == NULL) {
+		free(count);
+		return false;
+	}
+
+	dst = tmp;
+
+	for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+		size_t sum = 0;
+
+		memset(count, 0, RADIX_SIZE * sizeof(*count));
+
+		for (size_t i = 0; i < g->nwords; i++) {
+			count[(src[i].sig >> shift) & (RADIX_SIZE - 1)]++;
+		}
+
+		for (size_t i = 0; i < RADIX_SIZE; i++) {
+			const size_t n = count[i];
+
+			count[i] = sum;
+			sum += n;
+		}
+
+		for (size_t i = 0; i < g->nwords; i++) {
+			dst[count[(src[i].sig >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+		}
+
+		// Swap the buffers.
+		dst = src;
+		src = src == tmp ? g->words : tmp;
+	}
+
+	// An even number of passes leaves the result in the original array.
+	free(tmp);
+	free(count);
+	return true;
+}
+
+static int
+run_compare (const void *p1, const void *p2)
+{
+	const struct run *a = p1;
+	const struct run *b = p2;
+
+	return (a->first > b->first) - (a->first < b->first);
+}
+
+// Scratch space for delivering groups.
+struct emit {
+	struct anagram_groups *groups;
+	size_t *idx;
+	struct anagram_word *pubs;
+	const struct anagram_word **ptrs;
+	struct histogram a;
+	struct histogram b;
+};
+
+// Whether a word has the same letters as the histogram in #e->a.
+static bool
+same_letters (struct emit *e, const struct gword *w)
+{
+	const struct histogram *a = &e->a;
+	struct histogram *b = &e->b;
+
+	if (w->len != a->ntotal) {
+		return false;
+	}
+
+	histogram_fill(b, e->groups->arena + w->off, w->len);
+
+	return a->len == b->len
+	    && memcmp(a->bins, b->bins, a->len) == 0
+	    && memcmp(a->freq, b->freq, a->len * sizeof(*a->freq)) == 0;
+}
+
+// Deliver the groups in a run. Words with the same signature hash are almost
+// always anagrams, but the run is split on hash collisions to be sure.
+// Repeated words only count once. Returns false if the callback stopped.
+static bool
+emit_run (struct emit *e, const struct run *r, anagram_group_fn fn, void *arg)
+{
+	struct anagram_groups *g = e->groups;
+	size_t n = r->len;
+
+	for (size_t i = 0; i < n; i++) {
+		e->idx[i] = r->start + i;
+	}
+
+	while (n > 0) {
+		const struct gword *leader = &g->words[e->idx[0]];
+		struct anagram_group group = { .words = e->ptrs, .nwords = 0 };
+		size_t nrest = 0;
+
+		histogram_fill(&e->a, g->arena + leader->off, leader->len);
+
+		for (size_t i = 0; i < n; i++) {
+			const struct gword *w = &g->words[e->idx[i]];
+			const char *str = g->arena + w->off;
+			bool repeated = false;
+
+			// Keep other words for the next round.
+			if (i > 0 && !same_letters(e, w)) {
+				e->idx[nrest++] = e->idx[i];
+				continue;
+			}
+
+			for (size_t j = 0; j < group.nwords && !repeated; j++) {
+				repeated = memcmp(e->pubs[j].str, str, w->len) == 0;
+			}
+
+			if (!repeated) {
+				e->pubs[group.nwords].str = str;
+				e->pubs[group.nwords].len = w->len;
+				e->ptrs[group.nwords] = &e->pubs[group.nwords];
+				group.nwords++;
+			}
+		}
+
+		n = nrest;
+
+		if (group.nwords >= g->opts.minsize && !fn(&group, arg)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+anagram_groups_run (struct anagram_groups *g, anagram_group_fn fn, void *arg)
+{
+	struct run *runs = NULL;
+	size_t nruns = 0;
+	size_t maxrun = 0;
+	struct emit e = { .groups = g };
+	bool ret = false;
+
+	if (g->nwords == 0) {
+		return true;
+	}
+
+	if (!groups_sign(g)) {
+		return false;
+	}
+
+	// Bring words with the same signature together, in the order in which
+	// they were added.
+	if (!groups_sort(g)) {
+		return false;
+	}
+
+	// Collect the runs which are large enough to hold a group.
+	for (size_t i = 0, j; i < g->nwords; i = j) {
+		for (j = i + 1; j < g->nwords && g->words[j].sig == g->words[i].sig; j++) {
+			continue;
+		}
+
+		if (j - i < g->opts.minsize) {
+			continue;
+		}
+
+		if (nruns % 1024 == 0) {
+			struct run *r;
+
+			if ((r = realloc(runs, (nruns + 1024) * sizeof(*r))) == NULL) {
+				goto out;
+			}
+
+			runs = r;
+		}
+
+		runs[nruns].first = g->words[i].off;
+		runs[nruns].start = i;
+		runs[nruns].len   = j - i;
+		nruns++;
+
+		if (j - i > maxrun) {
+			maxrun = j - i;
+		}
+	}
+
+	if (nruns == 0) {
+		return true;
+	}
+
+	// Deliver the groups in the order of their first words.
+	qsort(runs, nruns, sizeof(*runs), run_compare);
+
+	if ((e.idx  = malloc(maxrun * sizeof(*e.idx)))  == NULL
+	 || (e.pubs = malloc(maxrun * sizeof(*e.pubs))) == NULL
+	 || (e.ptrs = malloc(maxrun * sizeof(*e.ptrs))) == NULL) {
+		goto out;
+	}
+
+	if (!scratch_init(&e.a, g->maxlen)) {
+		goto out;
+	}
+
+	if (!scratch_init(&e.b, g->maxlen)) {
+		scratch_free(&e.a);
+		goto out;
+	}
+
+	for (size_t i = 0; i < nruns; i++) {
+		if (!emit_run(&e, &runs[i], fn, arg)) {
+			break;
+		}
+	}
+
+	scratch_free(&e.a);
+	scratch_free(&e.b);
+	ret = true;
+
+out:	free(e.idx);
+	free(e.pubs);
+	free(e.ptrs);
+	free(runs);
+	return ret;
+}
@@ -20,39 +20,44 @@
 #include <string.h>	/* memmove() */
 #include "histogram.h"
 
+/* Strings up to this length are sorted by insertion sort: */
+#define HISTOGRAM_SHORT	32
+
 static int
 char_compare (const void *const p1, const void *const p2)
 {
 	return (*(char *const)p1 < *(char *const)p2) ? -1 : 1;
 }
 
-struct histogram *
-histogram_create (const char *str, const size_t len)
+void
+histogram_fill (struct histogram *h, const char *str, const size_t len)
 {
 	char *c;
 	char *p;
 	char *end;
-	void *tmp;
-	struct histogram *h;
 
-	if ((h = malloc(sizeof(*h))) == NULL) {
-		goto err_0;
-	}
-	/* Worst-case length of h->bins is same as input: */
-	if ((h->bins = malloc(len)) == NULL) {
-		goto err_1;
-	}
-	if ((h->freq = malloc(len * sizeof(*h->freq))) == NULL) {
-		goto err_2;
-	}
 	h->len = 0;
 	h->maxfreq = 0;
+	h->nwild = 0;
 
 	/* Copy input string to histogram bins area: */
 	memcpy(h->bins, str, len);
 
-	/* Alphabetically sort chars in string: */
-	qsort(h->bins, len, 1, char_compare);
+	/* Alphabetically sort chars in string. Words are short, and for short
+	 * strings an insertion sort beats the function calls of qsort(): */
+	if (len <= HISTOGRAM_SHORT) {
+		for (size_t i = 1; i < len; i++) {
+			const char k = h->bins[i];
+			size_t j = i;
+
+			for (; j > 0 && h->bins[j - 1] > k; j--) {
+				h->bins[j] = h->bins[j - 1];
+			}
+			h->bins[j] = k;
+		}
+	} else {
+		qsort(h->bins, len, 1, char_compare);
+	}
 
 	/* Total number of characters tallied in histogram must be equal
 	 * to length of input string: */
@@ -68,14 +73,40 @@ histogram_create (const char *str, const size_t len)
 			freq++;
 			c++;
 		}
+		/* Wildcards are counted, but get no bin: */
+		if (q == HISTOGRAM_WILDCARD) {
+			h->nwild = freq;
+			continue;
+		}
 		*p++ = q;
 		h->freq[h->len++] = freq;
 		if (freq > h->maxfreq) {
 			h->maxfreq = freq;
 		}
 	}
-	/* Trim memory blocks to fit: */
-	if (h->len < len) {
+}
+
+struct histogram *
+histogram_create (const char *str, const size_t len)
+{
+	void *tmp;
+	struct histogram *h;
+
+	if ((h = malloc(sizeof(*h))) == NULL) {
+		goto err_0;
+	}
+	/* Worst-case length of h->bins is same as input: */
+	if ((h->bins = malloc(len)) == NULL) {
+		goto err_1;
+	}
+	if ((h->freq = malloc(len * sizeof(*h->freq))) == NULL) {
+		goto err_2;
+	}
+	histogram_fill(h, str, len);
+
+	/* Trim memory blocks to fit. Wildcards have no bin, so there may be
+	 * none at all; realloc to zero would free the blocks: */
+	if (h->len > 0 && h->len < len) {
 		if ((tmp = realloc(h->bins, h->len)) != NULL) {
 			h->bins = tmp;
 		}
@@ -126,6 +157,33 @@ histogram_destroy (struct histogram **h)
 	*h = NULL;
 }
 
+void
+histogram_assign (struct histogram *dst, const struct histogram *src)
+{
+	memcpy(dst->freq, src->freq, src->len * sizeof(*src->freq));
+	dst->maxfreq = src->maxfreq;
+	dst->ntotal = src->ntotal;
+	dst->nwild = src->nwild;
+}
+
+size_t
+histogram_letters (const struct histogram *h, char *out)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < h->len; i++) {
+		for (int j = 0; j < h->freq[i]; j++) {
+			out[n++] = h->bins[i];
+		}
+	}
+
+	for (size_t i = 0; i < h->nwild; i++) {
+		out[n++] = HISTOGRAM_WILDCARD;
+	}
+
+	return n;
+}
+
 static inline const char *
 find_character (const struct histogram *h, const char c)
 {
@@ -141,9 +199,36 @@ find_character (const struct histogram *h, const char c)
 	return NULL;
 }
 
+// Check whether #h fits in #base, with the wildcards of #base covering the
+// characters that #h has in excess. The wildcards of #h need wildcards too.
+static bool
+fits_wild (const struct histogram *h, const struct histogram *base)
+{
+	size_t deficit = h->nwild;
+
+	if (h->ntotal > base->ntotal) {
+		return false;
+	}
+
+	for (const char *b, *t = h->bins; t < h->bins + h->len; t++) {
+		const int need = h->freq[t - h->bins];
+		const int have = (b = find_character(base, *t)) ? base->freq[b - base->bins] : 0;
+
+		if (need > have && (deficit += need - have) > base->nwild) {
+			return false;
+		}
+	}
+
+	return deficit <= base->nwild;
+}
+
 bool
 histogram_fits (const struct histogram *h, const struct histogram *base)
 {
+	if (base->nwild > 0 || h->nwild > 0) {
+		return fits_wild(h, base);
+	}
+
 	// The histogram cannot fit in the base histogram if it contains
 	// characters that the base does not.
 	if (h->len > base->len) {
@@ -175,6 +260,49 @@ histogram_fits (const struct histogram *h, const struct histogram *base)
 	return true;
 }
 
+// Subtract #from from #target, using the wildcards of #target for the
+// characters that it lacks.
+static bool
+subtract_wild (struct histogram *target, const struct histogram *from)
+{
+	size_t deficit = from->nwild;
+
+	if (!fits_wild(from, target)) {
+		return false;
+	}
+
+	for (const char *t, *f = from->bins; f < from->bins + from->len; f++) {
+		const int need = from->freq[f - from->bins];
+		int *have;
+
+		if ((t = find_character(target, *f)) == NULL) {
+			deficit += need;
+			continue;
+		}
+
+		have = &target->freq[t - target->bins];
+
+		if (need > *have) {
+			deficit += need - *have;
+			*have = 0;
+		} else {
+			*have -= need;
+		}
+	}
+
+	target->nwild  -= deficit;
+	target->ntotal -= from->ntotal;
+	target->maxfreq = 0;
+
+	for (size_t i = 0; i < target->len; i++) {
+		if (target->freq[i] > target->maxfreq) {
+			target->maxfreq = target->freq[i];
+		}
+	}
+
+	return true;
+}
+
 bool
 histogram_subtract (struct histogram *target, struct histogram *from)
 {
@@ -186,6 +314,10 @@ histogram_subtract (struct histogram *target, struct histogram *from)
 	/* Subtract the second histogram from the first. Modifies the first
 	 * histogram. Returns 1 on success, 0 on "underflow". */
 
+	if (target->nwild > 0 || from->nwild > 0) {
+		return subtract_wild(target, from);
+	}
+
 	target->maxfreq = 0;
 
 	for (f = from->bins, t = target->bins; f < from->bins + from->len; f++) {
@@ -218,5 +350,12 @@ histogram_subtract (struct histogram *target, struct histogram *from)
 			target->maxfreq = *freq_t;
 		}
 	}
+	/* Include the remaining chars of target in the max frequency: */
+	for (; t < target->bins + target->len; t++) {
+		freq_t = target->freq + (t - target->bins);
+		if (*freq_t > target->maxfreq) {
+			target->maxfreq = *freq_t;
+		}
+	}
 	return true;
 }
@@ -3,6 +3,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// Character that stands for any letter, like a blank tile.
+#define HISTOGRAM_WILDCARD	'?'
+
 struct histogram {
 
 	// Pointer to the array holding the characters.
@@ -17,14 +20,33 @@ struct histogram {
 	// Maximum character frequency found in this histogram.
 	int maxfreq;
 
-	// Total characters represented (length of source string).
+	// Total characters represented (length of source string), including
+	// the wildcards.
 	size_t ntotal;
+
+	// Number of wildcards, which are not in the bins. A wildcard in the
+	// base histogram covers one missing character in histogram_fits() and
+	// histogram_subtract().
+	size_t nwild;
 };
 
 extern struct histogram *histogram_create (const char *str, const size_t len);
+
+// Fill a histogram from a string without allocating. The #bins and #freq
+// arrays of the histogram must have room for #len entries.
+extern void histogram_fill (struct histogram *h, const char *str, const size_t len);
 extern struct histogram *histogram_copy (const struct histogram *orig);
 extern void histogram_destroy (struct histogram **h);
 
+// Copy the frequencies of #src into #dst. Both histograms must have the same
+// bins, for instance because one was copied from the other.
+extern void histogram_assign (struct histogram *dst, const struct histogram *src);
+
+// Write the characters of the histogram to #out in sorted order, each as many
+// times as its frequency, followed by the wildcards. Returns the number of
+// characters written, which is the total count of the histogram.
+extern size_t histogram_letters (const struct histogram *h, char *out);
+
 // Check if a given histogram #h "fits" inside the base histogram, meaning that
 // #h is a subset of the base and is wholly contained within the base.
 // Subtracting #h from the base will not cause an "underflow".
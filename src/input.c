@@ -110,15 +110,20 @@ input_from_args (const struct config *config, struct input *input)
 bool
 input_get (const struct config *config, struct input *input)
 {
-	// Try to get the input string from the command line arguments.
-	if (input_from_args(config, input)) {
-		return true;
+	// Try to get the input string from the command line arguments, else
+	// from standard input.
+	if (!input_from_args(config, input) && !input_from_stdin(input)) {
+		return false;
 	}
 
-	// Try to get the input string from standard input.
-	if (input_from_stdin(input)) {
-		return true;
+	// Count the wildcards.
+	input->nwild = 0;
+
+	for (size_t i = 0; i < input->len; i++) {
+		if (input->str[i] == HISTOGRAM_WILDCARD) {
+			input->nwild++;
+		}
 	}
 
-	return false;
+	return true;
 }
@@ -4,6 +4,7 @@
 #include <stddef.h>
 
 #include "config.h"
+#include "histogram.h"
 
 struct input {
 
@@ -13,8 +14,12 @@ struct input {
 
 	// Length of the input string in bytes.
 	size_t len;
+
+	// Number of wildcards in the input string.
+	size_t nwild;
 };
 
 // Get the input string from the command line arguments, or from standard input
-// if no arguments were given.
+// if no arguments were given. Every '?' in the input is a wildcard, which
+// stands for any one letter.
 extern bool input_get (const struct config *config, struct input *input);
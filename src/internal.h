@@ -0,0 +1,217 @@
+#pragma once
+
+// Definitions shared between the modules of the library, but not part of its
+// interface.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "anagram.h"
+#include "histogram.h"
+#include "trie.h"
+#include "wordset.h"
+
+struct word {
+
+	// Public view of the word, handed out to the result callback.
+	struct anagram_word pub;
+
+	// Histogram of the word.
+	struct histogram *hist;
+};
+
+struct anagram_dict {
+
+	// Array of words, in the order in which they were added.
+	struct word *words;
+
+	// Number of words in #words.
+	size_t nwords;
+
+	// Allocated capacity of #words.
+	size_t size;
+
+	// Optional histogram against which candidate words are filtered.
+	struct histogram *filter;
+
+	// Set of excluded words. The strings are owned by the dictionary.
+	struct wordset exclude;
+
+	// Set of the words in #words, to drop duplicates.
+	struct wordset unique;
+
+	// Whether to normalize words.
+	bool normalize;
+
+	// Minimum length of the words to keep.
+	size_t minlength;
+
+	// Load statistics.
+	struct anagram_dict_stats stats;
+
+	// Trie of the letter-sorted words, indexed like #words.
+	struct trie trie;
+
+	// Checksum over all words, in order.
+	uint64_t checksum;
+};
+
+struct anagram_query {
+
+	// The dictionary against which this query runs.
+	const struct anagram_dict *dict;
+
+	// Query options.
+	struct anagram_query_opts opts;
+
+	// Histogram of the input string, and the same minus the included words.
+	struct histogram *input;
+	struct histogram *hist;
+
+	// Number of letters in the input string.
+	size_t nletters;
+
+	// Array of included words, owned by the query.
+	struct anagram_word *include;
+
+	// Number of words in #include.
+	size_t ninclude;
+
+	// Whether the included words satisfy the length requirement.
+	bool include_satisfied;
+
+	// Array of indices of the dictionary words which fit in the input.
+	uint32_t *cand;
+
+	// Number of words in #cand.
+	size_t ncand;
+
+	// Length of the longest word in #cand.
+	size_t maxlen;
+
+	// For each candidate, indexed like the dictionary words, a bitmask of
+	// the bins of #hist which occur in the word. NULL if #hist has more bins
+	// than fit in a mask.
+	uint64_t *masks;
+
+	// Check value over everything that determines the search, stored in
+	// resume tokens to catch tokens from a different query.
+	uint32_t check;
+};
+
+// Find the letters which the wildcards of the input stand for in a result:
+// the letters of its words in excess of those in the input. Writes them to
+// #out in sorted order, and returns their number.
+extern size_t result_blanks (const struct anagram_query *q, const struct anagram_word *const *words, size_t nwords, char *out);
+
+// Strip surrounding whitespace from a word.
+extern void trim (const char **str, size_t *len);
+
+// Read a file with one word per line, and call the handler for each line.
+// Lines too long to be words are skipped. Stops and returns false when the
+// handler returns false.
+extern bool read_lines (const char *path, bool (*handler) (void *arg, const char *line, size_t len), void *arg);
+
+// Initial values of 32-bit and 64-bit FNV-1a hashes.
+#define FNV32_INIT	2166136261U
+#define FNV64_INIT	UINT64_C(14695981039346656037)
+
+// Update a 32-bit FNV-1a hash with a buffer.
+static inline uint32_t
+fnv32 (uint32_t h, const void *buf, size_t len)
+{
+	for (const unsigned char *c = buf; len--; c++) {
+		h ^= *c;
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+// Update a 64-bit FNV-1a hash with a buffer.
+static inline uint64_t
+fnv64 (uint64_t h, const void *buf, size_t len)
+{
+	for (const unsigned char *c = buf; len--; c++) {
+		h ^= *c;
+		h *= UINT64_C(1099511628211);
+	}
+
+	return h;
+}
+
+// Maximum length of an unsigned LEB128 varint.
+#define VARINT_MAX	10
+
+// Encode a varint at #pos in a buffer of #size bytes. Bytes which fall beyond
+// the end are not written. Returns the position after the varint, so the
+// caller can detect a short buffer by comparing it with #size.
+static inline size_t
+varint_put (uint8_t *buf, size_t size, size_t pos, uint64_t v)
+{
+	do {
+		const uint8_t b = (v & 0x7F) | (v > 0x7F ? 0x80 : 0);
+
+		if (pos < size) {
+			buf[pos] = b;
+		}
+		pos++;
+		v >>= 7;
+	} while (v > 0);
+
+	return pos;
+}
+
+// Decode a varint at #pos in a buffer of #size bytes, and advance #pos past
+// it. Returns false if the varint is truncated or too long.
+static inline bool
+varint_get (const uint8_t *buf, size_t size, size_t *pos, uint64_t *v)
+{
+	*v = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (*pos == size) {
+			return false;
+		}
+
+		*v |= (uint64_t) (buf[*pos] & 0x7F) << shift;
+
+		if ((buf[(*pos)++] & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Write a varint to a stream.
+static inline bool
+varint_write (FILE *fp, uint64_t v)
+{
+	uint8_t buf[VARINT_MAX];
+	const size_t n = varint_put(buf, sizeof(buf), 0, v);
+
+	return fwrite(buf, n, 1, fp) == 1;
+}
+
+// Read a varint from a stream. Returns false on a read error, or if the
+// varint is truncated or too long.
+static inline bool
+varint_read (FILE *fp, uint64_t *v)
+{
+	uint8_t buf[VARINT_MAX];
+	size_t n = 0, pos = 0;
+	int c;
+
+	// Collect the bytes up to and including the last one.
+	do {
+		if ((c = getc(fp)) == EOF) {
+			return false;
+		}
+		buf[n++] = c;
+	} while ((c & 0x80) && n < sizeof(buf));
+
+	return varint_get(buf, n, &pos, v);
+}
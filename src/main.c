@@ -16,246 +16,271 @@
  *
  */
 
-#include <unistd.h>	/* read() */
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
-#include <stdlib.h>	/* malloc() */
-#include <string.h>	/* memmove() */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "anagram.h"
+#include "checkpoint.h"
 #include "config.h"
-#include "histogram.h"
 #include "input.h"
+#include "output.h"
 
-struct word {
-	char *str;
-	size_t len;
-	struct histogram *hist;
-	struct word *next;
-};
+// Number of search levels between checks of the checkpoint timer.
+#define CHECKPOINT_LEVELS	(1 << 16)
 
-struct prev_word {
-	char *str;
-	size_t len;
-	struct prev_word *prev;
-};
-
-static struct word *word_head = NULL;
-static struct word *word_tail = NULL;
+// Set when a signal asks the search to stop.
+static volatile sig_atomic_t interrupted = 0;
 
 static void
 usage (const struct config *config)
 {
 	char *usage[] = {
 		"  -h|--help                  Show this help text",
-		"  -f|--dictfile <dictfile>   Use this dictionary file (one word per line)",
+		"  -f|--dictfile <dictfile>   Use this dictionary file (one word per line, repeatable)",
 		"  -m|--minlength <length>    All anagram words must be at least this long",
-		"  -l|--haslength <length>    One anagram word must be at least this long\n"
+		"  -l|--haslength <length>    One anagram word must be at least this long",
+		"  -i|--include <word>        All anagrams must contain this word (repeatable)",
+		"  -x|--exclude <word>        Do not use this dictionary word (repeatable)",
+		"  -X|--exclude-file <file>   Do not use the words in this file (repeatable)",
+		"  -p|--partial               Find words and phrases using a subset of the letters",
+		"  -u|--minused <count>       Sub-anagrams must use at least this many letters",
+		"  -G|--groups                List the groups of dictionary words that are anagrams",
+		"  -M|--min-group <count>     Only list groups of at least this many words (default: 2)",
+		"  -c|--cache-dir <dir>       Cache results in this directory",
+		"  -C|--cache-size <bytes>    Maximum cache size, with optional K, M or G suffix (default: 64M)",
+		"  -k|--checkpoint <file>     Save the search progress to this file regularly",
+		"  -K|--checkpoint-interval <s> Seconds between checkpoints (default: 60)",
+		"  -r|--resume <file>         Continue the search from this checkpoint",
+		"  -o|--output <format>       Output format: text, nul, ndjson or binary (default: text)",
+		"  -O|--index-file <file>     Write the table of word IDs to this file",
+		"  -g|--generator <list|trie> Candidate word generator (default: trie)",
+		"  -n|--normalize             Trim and lowercase the words and the input",
+		"  -s|--stats                 Print statistics to standard error\n"
 	};
 	unsigned int i;
 
 	fprintf(stderr, "\nFind anagrams of the input phrases (as argument, else standard input)\n");
-	fprintf(stderr, "Usage: %s [-h] [-f dictfile] [-m minlength] [-l haslength] words...\n\n", config->name);
+	fprintf(stderr, "Usage: %s [-h] [-f dictfile] [-m minlength] [-l haslength] [-i word] [-x word] [-X file] [-p] [-u count] [-G] [-M count] [-c dir] [-C size] [-k file] [-K seconds] [-r file] [-o format] [-O file] [-g generator] [-n] [-s] words...\n\n", config->name);
 
 	for (i = 0; i < sizeof(usage) / sizeof(usage[0]); i++) {
 		fprintf(stderr, "%s\n", usage[i]);
 	}
 }
 
-static int
-word_add (const char *const word, const size_t len, const struct histogram *const inhist)
+// Load the dictionary files given on the command line, or the default one if
+// none were given.
+static bool
+load_dictfiles (const struct config *config, struct anagram_dict *dict)
 {
-	struct word *w;
-	struct histogram *h;
-
-	if (len == 0) {
-		goto err_0;
-	}
-	/* If the word is longer than the input string, the word is out: */
-	if (len > inhist->ntotal) {
-		goto err_0;
-	}
-	if ((h = histogram_create(word, len)) == NULL) {
-		goto err_0;
-	}
-	/* If the word's histogram has more max occurrences than the input
-	 * histogram, the word cannot be part of the anagram (cheap check): */
-	if (h->maxfreq > inhist->maxfreq) {
-		goto err_1;
-	}
-	/* Further compare histograms; if the word has a higher occurrence
-	 * count for any given character than the input, then the word is out: */
-	if (!histogram_fits(h, inhist)) {
-		goto err_1;
-	}
-	if ((w = malloc(sizeof(*w))) == NULL) {
-		goto err_1;
+	if (config->dictfiles.ac == 0) {
+		return anagram_dict_add_file(dict, config->dictfile);
 	}
-	if ((w->str = malloc(len + 1)) == NULL) {
-		goto err_2;
-	}
-	w->len = len;
-	w->next = NULL;
-	memcpy(w->str, word, len);
-	w->str[len] = '\0';
-	w->hist = h;
-
-	/* Add word to linked list: */
-	if (word_head == NULL) {
-		word_head = word_tail = w;
-	}
-	else {
-		word_tail->next = w;
-		word_tail = w;
+
+	for (int i = 0; i < config->dictfiles.ac; i++) {
+		if (!anagram_dict_add_file(dict, config->dictfiles.av[i])) {
+			return false;
+		}
 	}
-	return 1;
 
-err_2:	free(w);
-err_1:	histogram_destroy(&h);
-err_0:	return 0;
+	return true;
 }
 
 static void
-words_find (const struct config *config, struct histogram *h, struct prev_word *prev, int len_satisfied)
+on_signal (int sig)
+{
+	(void) sig;
+	interrupted = 1;
+}
+
+static bool
+save_checkpoint (const struct config *config, const struct anagram_cursor *cursor)
 {
-	struct word *w;
-	struct histogram *copy;
-	struct prev_word pw;
-	struct prev_word *p;
-
-	/* If the anagram must contain a word of a minimum length, which has
-	 * not occurred so far, and there are not enough letters left in the
-	 * histogram to create words of that length, abort this branch: */
-	if (!len_satisfied && h->ntotal < config->haslength) {
-		return;
+	if (!checkpoint_save(config->checkpoint, cursor, stdout)) {
+		fprintf(stderr, "Could not write checkpoint\n");
+		return false;
 	}
-	/* Loop over all words; anagram may contain the same word more than once: */
-	for (w = word_head; w; w = w->next)
-	{
-		/* Skip word if longer than there are characters in the histogram: */
-		if (w->len > h->ntotal) {
-			continue;
+
+	return true;
+}
+
+// Run the search on a cursor, resuming from and saving checkpoints if asked.
+static bool
+run_cursor (const struct config *config, struct output *out, struct anagram_cursor *cursor)
+{
+	time_t last = time(NULL);
+
+	if (config->resume != NULL && !checkpoint_load(config->resume, cursor, stdout)) {
+		if (errno == EINVAL) {
+			fprintf(stderr, "Checkpoint does not match the query or the output\n");
+		} else {
+			fprintf(stderr, "Could not read checkpoint\n");
 		}
-		/* Skip word if its histogram does not fit into input histogram: */
-		if (histogram_fits(w->hist, h) == 0) {
-			continue;
+		return false;
+	}
+
+	if (!output_start(out, config->index_file, config->resume != NULL)) {
+		fprintf(stderr, "Could not write index file\n");
+		return false;
+	}
+
+	// Return regularly from the search to check the time, and save the
+	// progress when interrupted.
+	if (config->checkpoint != NULL) {
+		anagram_cursor_limit(cursor, CHECKPOINT_LEVELS);
+		signal(SIGINT,  on_signal);
+		signal(SIGTERM, on_signal);
+	}
+
+	while (!anagram_cursor_done(cursor)) {
+		if (!anagram_cursor_next(cursor, SIZE_MAX, output_result, out)) {
+			fprintf(stderr, "Out of memory\n");
+			return false;
 		}
-		if ((copy = histogram_copy(h)) == NULL) {
-			return;
+
+		if (config->checkpoint == NULL) {
+			continue;
 		}
-		if (!histogram_subtract(copy, w->hist)) {
-			histogram_destroy(&copy);
-			return;
+
+		if (interrupted) {
+			if (save_checkpoint(config, cursor)) {
+				fprintf(stderr, "Interrupted, progress saved to %s\n", config->checkpoint);
+			}
+			return false;
 		}
-		/* Empty histogram? Done! */
-		if (copy->ntotal == 0)
-		{
-			/* Ensure before printing that at least one of the words in
-			 * the anagram is at least 'anagram_contains_len' in length: */
-			if (len_satisfied || w->len >= config->haslength) {
-				fwrite(w->str, w->len, 1, stdout);
-				/* Backtrack over all previous words in this chain,
-				 * print them all in reverse order: */
-				for (p = prev; p; p = p->prev) {
-					fputc(' ', stdout);
-					fwrite(p->str, p->len, 1, stdout);
-				}
-				fputc('\n', stdout);
+
+		if (time(NULL) - last >= (time_t) config->checkpoint_interval) {
+			if (!save_checkpoint(config, cursor)) {
+				return false;
 			}
-			histogram_destroy(&copy);
-			return;
+			last = time(NULL);
 		}
-		/* Else recurse: */
-
-		/* Do something cute here: fill a prev_word structure on the
-		 * stack with the current word and current value of prev_word.
-		 * When a branch terminates, it backtracks over this list to
-		 * print out all the words in the chain leading up to it. We
-		 * essentially create a list on the stack of breadcrumbs of
-		 * where we came from: */
-		pw.str = w->str;
-		pw.len = w->len;
-		pw.prev = prev;
-		words_find(config, copy, &pw, (len_satisfied || w->len >= config->haslength));
-		histogram_destroy(&copy);
 	}
+
+	// Save the final state, so that resuming a finished search does not
+	// start it over.
+	return config->checkpoint == NULL || save_checkpoint(config, cursor);
 }
 
-static void
-words_destroy (void)
+// Run the query, through the cache if one was given.
+static bool
+run (const struct config *config, const struct input *input, const struct anagram_query *query, struct anagram_search_stats *ss, bool *hit)
 {
-	struct word *w;
-	struct word *t;
-
-	for (w = word_head; w; w = t) {
-		t = w->next;
-		histogram_destroy(&w->hist);
-		free(w->str);
-		free(w);
+	struct output out = {
+		.format   = config->output,
+		.fp       = stdout,
+		.query    = query,
+		.leftover = config->partial,
+		.blanks   = input->nwild > 0,
+	};
+	struct anagram_cache *cache;
+	struct anagram_cursor *cursor;
+	bool ret;
+
+	if (config->cache_dir != NULL) {
+		if ((cache = anagram_cache_open(config->cache_dir, config->cache_size)) == NULL) {
+			fprintf(stderr, "Could not open cache directory\n");
+			return false;
+		}
+
+		if (!output_start(&out, config->index_file, false)) {
+			fprintf(stderr, "Could not write index file\n");
+			anagram_cache_close(&cache);
+			return false;
+		}
+
+		if (!(ret = anagram_cache_run(cache, query, output_result, &out, hit, ss))) {
+			fprintf(stderr, errno == EIO ? "Could not read cache\n" : "Out of memory\n");
+		}
+
+		anagram_cache_close(&cache);
+		return ret;
 	}
-}
 
-static int
-char_compare (const void *const p1, const void *const p2)
-{
-	if (*(char *const)p1 == *(char *const)p2) {
-		return 0;
+	if ((cursor = anagram_cursor_create(query)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return false;
 	}
-	return (*(char *const)p1 < *(char *const)p2) ? -1 : 1;
+
+	ret = run_cursor(config, &out, cursor);
+	anagram_cursor_stats(cursor, ss);
+	anagram_cursor_destroy(&cursor);
+	return ret;
 }
 
+// List the anagram groups in the dictionary files.
 static int
-parse_dictfile (const struct config *config, const struct histogram *const inhist, size_t *max_found_len, size_t *nwords)
+run_groups (const struct config *config)
 {
-	FILE *fp = NULL;
-	char buf[10000];	/* Window chunk size, not max filesize */
-	char *c;
-	char *anchor;
-	size_t nbytes;
-	size_t len = 0;
-	int skip_word = 0;
-
-	if ((fp = fopen(config->dictfile, "r")) == NULL) {
-		return 0;
+	struct output out = {
+		.format = config->output,
+		.fp     = stdout,
+	};
+	struct anagram_groups *groups;
+	int ret = 1;
+
+	groups = anagram_groups_create(&(struct anagram_groups_opts) {
+		.minsize   = config->mingroup,
+		.nthreads  = 0,
+		.normalize = config->normalize,
+	});
+
+	if (groups == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
 	}
-	while ((nbytes = len + fread(buf + len, 1, sizeof(buf) - len, fp)) > 0)
-	{
-		/* Split on newlines: */
-		for (anchor = c = buf; c < buf + nbytes; c++) {
-			if (*c != '\n')
-			{
-				/* If already skipping this word, don't inspect the char: */
-				if (skip_word) {
-					continue;
-				}
-				/* Check if this char is in the list of chars in the
-				 * input string; if not, this word can never be part
-				 * of the anagram: */
-				if (bsearch(c, inhist->bins, inhist->len, 1, char_compare)) {
-					len++;
-				}
-				else {
-					skip_word = 1;
-				}
-				continue;
-			}
-			if (skip_word == 0 && len >= config->minlength) {
-				if (word_add(anchor, len, inhist)) {
-					if (len > *max_found_len) {
-						*max_found_len = len;
-					}
-					(*nwords)++;
-				}
-			}
-			anchor = c + 1;
-			len = 0;
-			skip_word = 0;
+
+	if (config->dictfiles.ac == 0) {
+		if (!anagram_groups_add_file(groups, config->dictfile)) {
+			fprintf(stderr, "Could not parse file\n");
+			goto out;
 		}
-		/* Move remainder to front of buffer: */
-		if (len > 0) {
-			memmove(buf, anchor, len);
+	}
+
+	for (int i = 0; i < config->dictfiles.ac; i++) {
+		if (!anagram_groups_add_file(groups, config->dictfiles.av[i])) {
+			fprintf(stderr, "Could not parse file\n");
+			goto out;
 		}
 	}
-	fclose(fp);
-	return 1;
+
+	if (!anagram_groups_run(groups, output_group, &out)) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+
+	if (config->print_stats) {
+		fprintf(stderr, "Anagram groups found:        %zu\n", out.count);
+	}
+
+	ret = 0;
+
+out:	anagram_groups_destroy(&groups);
+	return ret;
+}
+
+static void
+print_stats (const struct config *config, const struct anagram_dict *dict, const struct anagram_search_stats *ss, bool hit)
+{
+	struct anagram_dict_stats ds;
+
+	anagram_dict_stats(dict, &ds);
+
+	fprintf(stderr, "Dictionary words offered:    %zu\n", ds.offered);
+	fprintf(stderr, "Dictionary words kept:       %zu\n", ds.words);
+	fprintf(stderr, "Duplicate words dropped:     %zu\n", ds.duplicates);
+	fprintf(stderr, "Excluded words dropped:      %zu\n", ds.excluded);
+	if (config->cache_dir != NULL) {
+		fprintf(stderr, "Cache hit:                   %s\n", hit ? "yes" : "no");
+	}
+	fprintf(stderr, "Search levels entered:       %zu\n", ss->levels);
+	fprintf(stderr, "Pruned by letter coverage:   %zu\n", ss->pruned_letter);
+	fprintf(stderr, "Pruned by word lengths:      %zu\n", ss->pruned_length);
+	fprintf(stderr, "Anagrams found:              %zu\n", ss->results);
 }
 
 int
@@ -263,47 +288,119 @@ main (int argc, char *argv[])
 {
 	struct config config = config_default;
 	struct input  input;
-	struct histogram *inhist;
-	size_t max_found_len = 0;
-	size_t nwords = 0;
+	struct anagram_dict  *dict;
+	struct anagram_query *query;
+	struct anagram_search_stats ss = { 0 };
+	bool hit = false;
+	int ret = 1;
 
 	// Parse the command line options.
 	if (!args_parse(&config, &(struct args) { .ac = argc, .av = argv })) {
 		usage(&config);
+		args_free(&config);
 		return 1;
 	}
 
 	// Check if the user just wants the help message.
 	if (config.print_help) {
 		usage(&config);
+		args_free(&config);
 		return 0;
 	}
 
+	// The machine formats are never read by a person as they come, so
+	// buffer them fully, also when the output is a terminal.
+	if (config.output != OUTPUT_TEXT) {
+		setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+	}
+
+	// Group mode needs no input.
+	if (config.groups) {
+		ret = run_groups(&config);
+		args_free(&config);
+		return ret;
+	}
+
 	// Get the input string from the command line arguments or stdin.
 	if (!input_get(&config, &input)) {
+		args_free(&config);
 		return 1;
 	}
 
-	/* Create histogram of input string: */
-	if ((inhist = histogram_create(input.str, input.len)) == NULL) {
-		fprintf(stderr, "Could not create histogram of input\n");
-		free(input.str);
-		return 1;
+	// Normalize the input like the dictionary words.
+	if (config.normalize) {
+		for (size_t i = 0; i < input.len; i++) {
+			input.str[i] = tolower((unsigned char) input.str[i]);
+		}
+	}
+
+	// Create the dictionary. Only words which fit in the input are kept.
+	dict = anagram_dict_create(&(struct anagram_dict_opts) {
+		.filter     = input.str,
+		.filter_len = input.len,
+		.normalize  = config.normalize,
+		.minlength  = config.minlength,
+	});
+
+	if (dict == NULL) {
+		fprintf(stderr, "Could not create dictionary\n");
+		goto err_0;
+	}
+
+	// Drop the excluded words. This must happen before the dictionary is
+	// parsed.
+	for (int i = 0; i < config.exclude.ac; i++) {
+		const char *word = config.exclude.av[i];
+
+		if (!anagram_dict_exclude_word(dict, word, strlen(word))) {
+			fprintf(stderr, "Could not exclude word\n");
+			goto err_1;
+		}
+	}
+
+	for (int i = 0; i < config.exclude_files.ac; i++) {
+		if (!anagram_dict_exclude_file(dict, config.exclude_files.av[i])) {
+			fprintf(stderr, "Could not parse file\n");
+			goto err_1;
+		}
 	}
-	/* Parse the dictionary file: */
-	if (parse_dictfile(&config, inhist, &max_found_len, &nwords) == 0) {
+
+	// Parse the dictionary files.
+	if (!load_dictfiles(&config, dict)) {
 		fprintf(stderr, "Could not parse file\n");
-		histogram_destroy(&inhist);
-		free(input.str);
-		return 1;
+		goto err_1;
 	}
-	/* Check that we have words, and at least one has a length of at least
-	 * 'anagram_contains_len': */
-	if (max_found_len >= config.haslength && nwords > 0) {
-		words_find(&config, inhist, NULL, 0);
+
+	query = anagram_query_create(dict, input.str, input.len, &(struct anagram_query_opts) {
+		.minlength = config.minlength,
+		.haslength = config.haslength,
+		.include   = (const char *const *) config.include.av,
+		.ninclude  = config.include.ac,
+		.generator = config.generator,
+		.partial   = config.partial,
+		.minused   = config.minused,
+	});
+
+	if (query == NULL) {
+		if (errno == EINVAL) {
+			fprintf(stderr, "Included words do not fit in the input\n");
+		} else {
+			fprintf(stderr, "Could not create query\n");
+		}
+		goto err_1;
+	}
+
+	if (run(&config, &input, query, &ss, &hit)) {
+		ret = 0;
 	}
-	words_destroy();
-	histogram_destroy(&inhist);
-	free(input.str);
-	return 0;
+
+	if (config.print_stats) {
+		print_stats(&config, dict, &ss, hit);
+	}
+
+	anagram_query_destroy(&query);
+err_1:	anagram_dict_destroy(&dict);
+err_0:	free(input.str);
+	args_free(&config);
+	return ret;
 }
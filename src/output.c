@@ -0,0 +1,208 @@
+#include <stdint.h>
+
+#include "internal.h"
+#include "output.h"
+
+// Write a string prefixed with its length.
+static void
+put_bytes (FILE *fp, const char *str, size_t len)
+{
+	varint_write(fp, len);
+	fwrite(str, len, 1, fp);
+}
+
+// Write a string as a quoted JSON string. Bytes outside of ASCII are copied
+// as they are.
+static void
+put_json (FILE *fp, const char *str, size_t len)
+{
+	fputc('"', fp);
+
+	for (size_t i = 0; i < len; i++) {
+		const unsigned char c = str[i];
+
+		if (c == '"' || c == '\\') {
+			fputc('\\', fp);
+			fputc(c, fp);
+		} else if (c < 0x20) {
+			fprintf(fp, "\\u%04x", c);
+		} else {
+			fputc(c, fp);
+		}
+	}
+
+	fputc('"', fp);
+}
+
+bool
+output_start (const struct output *out, const char *index_file, bool resumed)
+{
+	const size_t nwords = anagram_query_nwords(out->query);
+	FILE *fp;
+
+	if (index_file != NULL) {
+		if ((fp = fopen(index_file, "w")) == NULL) {
+			return false;
+		}
+
+		for (size_t i = 0; i < nwords; i++) {
+			const struct anagram_word *w = anagram_query_word(out->query, i);
+
+			fwrite(w->str, w->len, 1, fp);
+			fputc('\n', fp);
+		}
+
+		if (fclose(fp) != 0) {
+			return false;
+		}
+	}
+
+	if (out->format != OUTPUT_BINARY || resumed) {
+		return true;
+	}
+
+	// The table in the stream: the number of words, and each word.
+	if (index_file != NULL) {
+		varint_write(out->fp, 0);
+		return true;
+	}
+
+	varint_write(out->fp, nwords);
+
+	for (size_t i = 0; i < nwords; i++) {
+		const struct anagram_word *w = anagram_query_word(out->query, i);
+
+		put_bytes(out->fp, w->str, w->len);
+	}
+
+	return true;
+}
+
+static void
+result_text (const struct output *out, const struct anagram_result *result)
+{
+	// Print the words in reverse order of discovery, last word first.
+	for (size_t i = result->nwords; i > 0; i--) {
+		const struct anagram_word *w = result->words[i - 1];
+
+		fwrite(w->str, w->len, 1, out->fp);
+
+		if (i > 1) {
+			fputc(' ', out->fp);
+		}
+	}
+
+	// In partial mode, add the leftover letters after a tab.
+	if (out->leftover) {
+		fputc('\t', out->fp);
+		fwrite(result->leftover, result->nleftover, 1, out->fp);
+	}
+
+	// If the input has wildcards, add the letters they stand for after
+	// another tab.
+	if (out->blanks) {
+		fputc('\t', out->fp);
+		fwrite(result->blanks, result->nblanks, 1, out->fp);
+	}
+
+	fputc(out->format == OUTPUT_NUL ? '\0' : '\n', out->fp);
+}
+
+static void
+result_ndjson (const struct output *out, const struct anagram_result *result)
+{
+	fputs("{\"words\":[", out->fp);
+
+	for (size_t i = result->nwords; i > 0; i--) {
+		const struct anagram_word *w = result->words[i - 1];
+
+		put_json(out->fp, w->str, w->len);
+
+		if (i > 1) {
+			fputc(',', out->fp);
+		}
+	}
+
+	fputc(']', out->fp);
+
+	if (out->leftover) {
+		fputs(",\"leftover\":", out->fp);
+		put_json(out->fp, result->leftover, result->nleftover);
+	}
+
+	if (out->blanks) {
+		fputs(",\"blanks\":", out->fp);
+		put_json(out->fp, result->blanks, result->nblanks);
+	}
+
+	fputs("}\n", out->fp);
+}
+
+static void
+result_binary (const struct output *out, const struct anagram_result *result)
+{
+	// The words come in the same order as in the text output.
+	varint_write(out->fp, result->nwords);
+
+	for (size_t i = result->nwords; i > 0; i--) {
+		varint_write(out->fp, anagram_query_word_id(out->query, result->words[i - 1]));
+	}
+
+	if (out->leftover) {
+		put_bytes(out->fp, result->leftover, result->nleftover);
+	}
+
+	if (out->blanks) {
+		put_bytes(out->fp, result->blanks, result->nblanks);
+	}
+}
+
+bool
+output_result (const struct anagram_result *result, void *arg)
+{
+	struct output *out = arg;
+
+	out->count++;
+
+	switch (out->format) {
+	case OUTPUT_NDJSON:
+		result_ndjson(out, result);
+		break;
+
+	case OUTPUT_BINARY:
+		result_binary(out, result);
+		break;
+
+	default:
+		result_text(out, result);
+		break;
+	}
+
+	return true;
+}
+
+bool
+output_group (const struct anagram_group *group, void *arg)
+{
+	struct output *out = arg;
+
+	out->count++;
+
+	if (out->format == OUTPUT_NDJSON) {
+		fputs("{\"words\":[", out->fp);
+	}
+
+	for (size_t i = 0; i < group->nwords; i++) {
+		const struct anagram_word *w = group->words[i];
+
+		if (out->format == OUTPUT_NDJSON) {
+			put_json(out->fp, w->str, w->len);
+			fputs(i + 1 < group->nwords ? "," : "]}\n", out->fp);
+		} else {
+			fwrite(w->str, w->len, 1, out->fp);
+			fputc(i + 1 < group->nwords ? ' ' : out->format == OUTPUT_NUL ? '\0' : '\n', out->fp);
+		}
+	}
+
+	return true;
+}
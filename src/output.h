@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "anagram.h"
+
+// Ways to print the results.
+enum output_format {
+
+	// One line per result, with the words separated by spaces.
+	OUTPUT_TEXT,
+
+	// Like text, but each result ends in a NUL byte instead of a newline.
+	OUTPUT_NUL,
+
+	// One JSON object per line.
+	OUTPUT_NDJSON,
+
+	// Each result as its number of words, followed by their word IDs, all
+	// as varints. The strings of the IDs are in a table which comes first.
+	OUTPUT_BINARY,
+};
+
+struct output {
+
+	// Output format and stream.
+	enum output_format format;
+	FILE *fp;
+
+	// The query whose results are printed, for the word IDs.
+	const struct anagram_query *query;
+
+	// Print the leftover letters, in partial mode.
+	bool leftover;
+
+	// Print the letters which the wildcards stand for.
+	bool blanks;
+
+	// Number of results or groups printed so far.
+	size_t count;
+};
+
+// Write the table of word IDs before the first result. If #index_file is not
+// NULL, the table is written to that file, one word per line, in which case
+// the table in a binary stream is empty. Otherwise, only a binary stream gets
+// the table. If #resumed, the stream already holds its table.
+extern bool output_start (const struct output *out, const char *index_file, bool resumed);
+
+// Result callback which prints the result to the output.
+extern bool output_result (const struct anagram_result *result, void *arg);
+
+// Group callback which prints the group to the output. Groups have no word
+// IDs, so the binary format does not apply.
+extern bool output_group (const struct anagram_group *group, void *arg);
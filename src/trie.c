@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trie.h"
+
+// Initial number of nodes and words to allocate room for.
+#define TRIE_SIZE	1024
+
+static int
+index_compare (const void *const p1, const void *const p2)
+{
+	const uint32_t a = *(const uint32_t *) p1;
+	const uint32_t b = *(const uint32_t *) p2;
+
+	return (a > b) - (a < b);
+}
+
+bool
+trie_init (struct trie *trie)
+{
+	memset(trie, 0, sizeof(*trie));
+
+	if ((trie->nodes = calloc(TRIE_SIZE, sizeof(*trie->nodes))) == NULL) {
+		return false;
+	}
+
+	if ((trie->next = malloc(TRIE_SIZE * sizeof(*trie->next))) == NULL) {
+		free(trie->nodes);
+		return false;
+	}
+
+	// Node zero is the root.
+	trie->nnodes     = 1;
+	trie->nodes_size = TRIE_SIZE;
+	trie->next_size  = TRIE_SIZE;
+	return true;
+}
+
+void
+trie_free (struct trie *trie)
+{
+	free(trie->nodes);
+	free(trie->next);
+	memset(trie, 0, sizeof(*trie));
+}
+
+// Find the child of #node for character #c, or insert it. Returns the index of
+// the child, or zero on allocation failure.
+static uint32_t
+child_get (struct trie *trie, const uint32_t node, const char c)
+{
+	uint32_t *link = &trie->nodes[node].child;
+	uint32_t n;
+
+	// Walk the sorted list of children.
+	while (*link != 0 && trie->nodes[*link].c < c) {
+		link = &trie->nodes[*link].sibling;
+	}
+
+	if (*link != 0 && trie->nodes[*link].c == c) {
+		return *link;
+	}
+
+	if (trie->nnodes == trie->nodes_size) {
+		const uint32_t size = trie->nodes_size * 2;
+		const ptrdiff_t off = (char *) link - (char *) trie->nodes;
+		struct trie_node *nodes;
+
+		if ((nodes = realloc(trie->nodes, size * sizeof(*nodes))) == NULL) {
+			return 0;
+		}
+
+		// The link may point into the old array.
+		link = (uint32_t *) ((char *) nodes + off);
+		trie->nodes      = nodes;
+		trie->nodes_size = size;
+	}
+
+	n = trie->nnodes++;
+	trie->nodes[n].c       = c;
+	trie->nodes[n].child   = 0;
+	trie->nodes[n].sibling = *link;
+	trie->nodes[n].word    = 0;
+	*link = n;
+
+	return n;
+}
+
+bool
+trie_insert (struct trie *trie, const struct histogram *h)
+{
+	uint32_t node = 0;
+
+	if (trie->nwords == trie->next_size) {
+		const uint32_t size = trie->next_size * 2;
+		uint32_t *next;
+
+		if ((next = realloc(trie->next, size * sizeof(*next))) == NULL) {
+			return false;
+		}
+
+		trie->next      = next;
+		trie->next_size = size;
+	}
+
+	// Follow the characters of the word in alphabetical order.
+	for (size_t i = 0; i < h->len; i++) {
+		for (int j = 0; j < h->freq[i]; j++) {
+			if ((node = child_get(trie, node, h->bins[i])) == 0) {
+				return false;
+			}
+		}
+	}
+
+	// Prepend the word to the list of words ending in this node.
+	trie->next[trie->nwords] = trie->nodes[node].word;
+	trie->nodes[node].word   = ++trie->nwords;
+	return true;
+}
+
+struct walk {
+	const struct trie *trie;
+	const char *bins;
+	size_t len;
+	int freq[256];
+	size_t nwild;
+	size_t minlength;
+	uint32_t *out;
+	size_t nout;
+};
+
+static void
+walk (struct walk *w, const uint32_t node, size_t bin, const size_t depth)
+{
+	const struct trie_node *nodes = w->trie->nodes;
+
+	// Both the children and the histogram bins are sorted, so walk them in
+	// lockstep. Only descend into children whose character is left, or for
+	// which a wildcard is left. A character that is left is always used
+	// before a wildcard, which can then still stand in for another.
+	for (uint32_t n = nodes[node].child; n != 0; n = nodes[n].sibling) {
+		bool real;
+
+		while (bin < w->len && w->bins[bin] < nodes[n].c) {
+			bin++;
+		}
+
+		if (bin == w->len && w->nwild == 0) {
+			return;
+		}
+
+		real = bin < w->len && w->bins[bin] == nodes[n].c && w->freq[bin] > 0;
+
+		if (!real && w->nwild == 0) {
+			continue;
+		}
+
+		if (real) {
+			w->freq[bin]--;
+		} else {
+			w->nwild--;
+		}
+
+		if (depth + 1 >= w->minlength) {
+			for (uint32_t i = nodes[n].word; i != 0; i = w->trie->next[i - 1]) {
+				w->out[w->nout++] = i - 1;
+			}
+		}
+
+		walk(w, n, bin, depth + 1);
+
+		if (real) {
+			w->freq[bin]++;
+		} else {
+			w->nwild++;
+		}
+	}
+}
+
+size_t
+trie_find (const struct trie *trie, const struct histogram *h, size_t minlength, uint32_t *out)
+{
+	struct walk w = {
+		.trie      = trie,
+		.bins      = h->bins,
+		.len       = h->len,
+		.nwild     = h->nwild,
+		.minlength = minlength,
+		.out       = out,
+		.nout      = 0,
+	};
+
+	// The bins hold unique characters, so there are at most 256 of them.
+	memcpy(w.freq, h->freq, h->len * sizeof(*h->freq));
+	walk(&w, 0, 0, 0);
+
+	// Return the words in the order in which they were inserted.
+	qsort(out, w.nout, sizeof(*out), index_compare);
+	return w.nout;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+// A trie of letter-sorted words. Each path from the root spells out the
+// characters of a word in alphabetical order, so all words with the same
+// histogram end in the same node. Words are identified by their index, which
+// must be dense and increasing.
+struct trie {
+
+	// Flat array of nodes, the root at index zero.
+	struct trie_node {
+
+		// Character on the edge leading to this node.
+		char c;
+
+		// Index of the first child, zero if none. Children are sorted by
+		// ascending character.
+		uint32_t child;
+
+		// Index of the next sibling, zero if none.
+		uint32_t sibling;
+
+		// Index plus one of the first word ending in this node, zero if
+		// none.
+		uint32_t word;
+	} *nodes;
+
+	// Number of nodes in use and allocated.
+	uint32_t nnodes;
+	uint32_t nodes_size;
+
+	// For each word, index plus one of the next word ending in the same
+	// node, zero if none.
+	uint32_t *next;
+
+	// Number of words in use and allocated.
+	uint32_t nwords;
+	uint32_t next_size;
+};
+
+extern bool trie_init (struct trie *trie);
+extern void trie_free (struct trie *trie);
+
+// Insert a word with the given histogram. The word gets the next index.
+extern bool trie_insert (struct trie *trie, const struct histogram *h);
+
+// Find all words of at least #minlength characters which fit in the
+// histogram, using its wildcards for missing characters. The word indices are
+// appended to #out, which must have room for all words in the trie, in
+// ascending order. Returns the number of words.
+extern size_t trie_find (const struct trie *trie, const struct histogram *h, size_t minlength, uint32_t *out);
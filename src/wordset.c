@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal.h"
+
+// Initial number of slots, must be a power of two.
+#define WORDSET_SIZE	1024
+
+// Find the slot holding the word, or the empty slot where it would go.
+static struct wordset_slot *
+lookup (const struct wordset *set, const char *str, size_t len, uint32_t h)
+{
+	const size_t mask = set->size - 1;
+
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		struct wordset_slot *s = &set->slots[i];
+
+		if (s->str == NULL) {
+			return s;
+		}
+
+		if (s->hash == h && s->len == len && memcmp(s->str, str, len) == 0) {
+			return s;
+		}
+	}
+}
+
+static bool
+grow (struct wordset *set)
+{
+	struct wordset old = *set;
+
+	set->size *= 2;
+
+	if ((set->slots = calloc(set->size, sizeof(*set->slots))) == NULL) {
+		*set = old;
+		return false;
+	}
+
+	for (size_t i = 0; i < old.size; i++) {
+		if (old.slots[i].str != NULL) {
+			*lookup(set, old.slots[i].str, old.slots[i].len, old.slots[i].hash) = old.slots[i];
+		}
+	}
+
+	free(old.slots);
+	return true;
+}
+
+bool
+wordset_init (struct wordset *set)
+{
+	set->size  = WORDSET_SIZE;
+	set->nused = 0;
+
+	return (set->slots = calloc(set->size, sizeof(*set->slots))) != NULL;
+}
+
+void
+wordset_free (struct wordset *set)
+{
+	free(set->slots);
+	set->slots = NULL;
+	set->size  = 0;
+	set->nused = 0;
+}
+
+bool
+wordset_contains (const struct wordset *set, const char *str, size_t len)
+{
+	if (set->nused == 0) {
+		return false;
+	}
+
+	return lookup(set, str, len, fnv32(FNV32_INIT, str, len))->str != NULL;
+}
+
+bool
+wordset_add (struct wordset *set, const char *str, size_t len, bool *added)
+{
+	const uint32_t h = fnv32(FNV32_INIT, str, len);
+	struct wordset_slot *s;
+
+	// Keep the load factor below one half.
+	if (set->nused + 1 > set->size / 2 && !grow(set)) {
+		return false;
+	}
+
+	if ((s = lookup(set, str, len, h))->str != NULL) {
+		*added = false;
+		return true;
+	}
+
+	s->str  = str;
+	s->len  = len;
+	s->hash = h;
+	set->nused++;
+
+	*added = true;
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A hash set of strings. The set does not own the strings; they must remain
+// valid for as long as they are in the set.
+struct wordset {
+
+	// Array of slots, each either empty (NULL string) or holding a word.
+	struct wordset_slot {
+		const char *str;
+		size_t      len;
+		uint32_t    hash;
+	} *slots;
+
+	// Number of slots, always a power of two.
+	size_t size;
+
+	// Number of occupied slots.
+	size_t nused;
+};
+
+extern bool wordset_init (struct wordset *set);
+extern void wordset_free (struct wordset *set);
+
+// Check whether the given word is in the set.
+extern bool wordset_contains (const struct wordset *set, const char *str, size_t len);
+
+// Add a word to the set. Sets #added to false if the word was already in the
+// set. Returns false on allocation failure.
+extern bool wordset_add (struct wordset *set, const char *str, size_t len, bool *added);
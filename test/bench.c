@@ -0,0 +1,96 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../src/anagram.h"
+
+/* Benchmark the candidate word generators against each other. Usage:
+ *
+ *   ./test/bench <dictfile> <words...>
+ */
+
+static const struct {
+	const char *name;
+	enum anagram_generator generator;
+} generators[] = {
+	{ "list", ANAGRAM_GENERATOR_LIST },
+	{ "trie", ANAGRAM_GENERATOR_TRIE },
+};
+
+static bool
+count_result (const struct anagram_result *result, void *arg)
+{
+	(void) result;
+	(*(size_t *) arg)++;
+	return true;
+}
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main (int argc, char *argv[])
+{
+	char input[256];
+	size_t len = 0;
+	size_t counts[2];
+	struct anagram_dict *dict;
+	double start;
+	int ret = 0;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <dictfile> <words...>\n", argv[0]);
+		return 1;
+	}
+
+	/* Concatenate the words: */
+	for (int i = 2; i < argc; i++) {
+		for (const char *c = argv[i]; *c && len < sizeof(input); c++) {
+			if (*c != ' ') {
+				input[len++] = *c;
+			}
+		}
+	}
+
+	start = now();
+	if ((dict = anagram_dict_create(NULL)) == NULL || !anagram_dict_add_file(dict, argv[1])) {
+		fprintf(stderr, "Could not load %s\n", argv[1]);
+		anagram_dict_destroy(&dict);
+		return 1;
+	}
+	printf("load: %zu words in %.3f s\n", anagram_dict_size(dict), now() - start);
+
+	for (size_t i = 0; i < sizeof(generators) / sizeof(generators[0]); i++) {
+		struct anagram_query *q;
+		struct anagram_query_opts opts = anagram_query_opts_default;
+
+		opts.generator = generators[i].generator;
+		counts[i] = 0;
+
+		start = now();
+		if ((q = anagram_query_create(dict, input, len, &opts)) == NULL) {
+			ret = 1;
+			break;
+		}
+		if (!anagram_query_run(q, count_result, &counts[i])) {
+			ret = 1;
+		}
+		anagram_query_destroy(&q);
+		printf("%s: %zu anagrams in %.3f s\n", generators[i].name, counts[i], now() - start);
+	}
+
+	if (ret == 0 && counts[0] != counts[1]) {
+		printf("FAILED: generators disagree\n");
+		ret = 1;
+	}
+
+	anagram_dict_destroy(&dict);
+	return ret;
+}
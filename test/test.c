@@ -1,8 +1,774 @@
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/anagram.h"
+#include "../src/checkpoint.h"
 #include "../src/histogram.h"
+#include "../src/output.h"
 
 #define ASSERT(x) if (!(x)) { printf("FAILED: line %d\n", __LINE__); ret = 1; }
 
+static bool
+count_result (const struct anagram_result *result, void *arg)
+{
+	(void) result;
+	(*(int *) arg)++;
+	return true;
+}
+
+static bool
+stop_result (const struct anagram_result *result, void *arg)
+{
+	(void) result;
+	(*(int *) arg)++;
+	return false;
+}
+
+// Append the words of a result to a string.
+static bool
+join_result (const struct anagram_result *result, void *arg)
+{
+	for (size_t i = 0; i < result->nwords; i++) {
+		strncat(arg, result->words[i]->str, result->words[i]->len);
+	}
+	strcat(arg, ",");
+	return true;
+}
+
+// Create a dictionary from a NULL-terminated list of words.
+static struct anagram_dict *
+dict_words (const char *const *words)
+{
+	struct anagram_dict *dict = anagram_dict_create(NULL);
+
+	for (; dict != NULL && *words != NULL; words++) {
+		if (!anagram_dict_add_word(dict, *words, strlen(*words))) {
+			anagram_dict_destroy(&dict);
+		}
+	}
+
+	return dict;
+}
+
+// The dictionary which most tests share: 'ab', 'a' and 'b'.
+static struct anagram_dict *
+dict_ab (void)
+{
+	return dict_words((const char *[]) { "ab", "a", "b", NULL });
+}
+
+static int
+test_cache (void)
+{
+	int ret = 0;
+	char dir[] = "/tmp/anagram-test-XXXXXX";
+	char miss[64] = "", hit[64] = "", path[512];
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	struct anagram_cache *cache;
+	struct anagram_search_stats stats;
+	struct dirent *de;
+	bool was_hit;
+	DIR *d;
+
+	ASSERT(mkdtemp(dir) != NULL);
+	ASSERT((cache = anagram_cache_open(dir, 1 << 20)) != NULL);
+
+	dict = dict_ab();
+	ASSERT(dict != NULL);
+
+	/* The first run fills the cache: */
+	q = anagram_query_create(dict, "ab", 2, NULL);
+	ASSERT(anagram_cache_run(cache, q, join_result, miss, &was_hit, &stats));
+	ASSERT(!was_hit);
+	ASSERT(stats.results == 3);
+	anagram_query_destroy(&q);
+
+	/* The same letters in a different order hit the cache: */
+	q = anagram_query_create(dict, "ba", 2, NULL);
+	ASSERT(anagram_cache_run(cache, q, join_result, hit, &was_hit, &stats));
+	ASSERT(was_hit);
+	ASSERT(stats.results == 3);
+	ASSERT(strcmp(miss, hit) == 0);
+	anagram_query_destroy(&q);
+
+	anagram_dict_destroy(&dict);
+	anagram_cache_close(&cache);
+	ASSERT(cache == NULL);
+
+	/* Clean up: */
+	if ((d = opendir(dir)) != NULL) {
+		while ((de = readdir(d)) != NULL) {
+			if (de->d_name[0] != '.' || strcmp(de->d_name, ".lock") == 0) {
+				snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+				unlink(path);
+			}
+		}
+		closedir(d);
+	}
+	rmdir(dir);
+	return ret;
+}
+
+// Append the leftover letters of a result to a string.
+static bool
+leftover_result (const struct anagram_result *result, void *arg)
+{
+	strncat(arg, result->leftover, result->nleftover);
+	strcat(arg, ",");
+	return true;
+}
+
+static int
+test_partial (void)
+{
+	int ret = 0;
+	int n = 0;
+	char words[64] = "", left[64] = "";
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+
+	dict = dict_ab();
+	ASSERT(dict != NULL);
+
+	/* 'ab', 'a', 'a b' and 'b', but not 'b a': */
+	q = anagram_query_create(dict, "abc", 3, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.partial   = true,
+	});
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 4);
+	ASSERT(anagram_query_run(q, leftover_result, left));
+	ASSERT(strcmp(left, "c,bc,c,ac,") == 0);
+	anagram_query_destroy(&q);
+
+	/* Only 'ab' and 'a b' use two letters: */
+	n = 0;
+	q = anagram_query_create(dict, "abc", 3, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.partial   = true,
+		.minused   = 2,
+	});
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 2);
+	anagram_query_destroy(&q);
+
+	/* Repeated letters: 'ab ab', 'ab a b' and 'a a b b' use four: */
+	n = 0;
+	words[0] = left[0] = '\0';
+	q = anagram_query_create(dict, "aabbc", 5, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.partial   = true,
+		.minused   = 4,
+	});
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 3);
+	ASSERT(anagram_query_run(q, join_result, words));
+	ASSERT(strcmp(words, "abab,abab,aabb,") == 0);
+	ASSERT(anagram_query_run(q, leftover_result, left));
+	ASSERT(strcmp(left, "c,c,c,") == 0);
+	anagram_query_destroy(&q);
+
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+// Append the letters which the wildcards stand for to a string.
+static bool
+blanks_result (const struct anagram_result *result, void *arg)
+{
+	strncat(arg, result->blanks, result->nblanks);
+	strcat(arg, ",");
+	return true;
+}
+
+static int
+test_wildcard (void)
+{
+	int ret = 0;
+	int n = 0;
+	char words[64] = "", blanks[64] = "";
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+
+	dict = dict_ab();
+	ASSERT(dict != NULL);
+	ASSERT(anagram_dict_add_word(dict, "c", 1));
+
+	/* Words with wildcards are skipped: */
+	ASSERT(anagram_dict_add_word(dict, "b?", 2));
+	ASSERT(anagram_dict_add_word(dict, "?", 1));
+	ASSERT(anagram_dict_size(dict) == 4);
+
+	/* An input of only wildcards: 'ab' and every pair of the three letters: */
+	q = anagram_query_create(dict, "??", 2, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+	});
+	ASSERT(q != NULL);
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 10);
+	anagram_query_destroy(&q);
+
+	/* The wildcard can be any letter, including one that is left: */
+	q = anagram_query_create(dict, "a?", 2, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+	});
+	ASSERT(anagram_query_run(q, join_result, words));
+	ASSERT(strcmp(words, "ab,aa,ab,ac,ba,ca,") == 0);
+	ASSERT(anagram_query_run(q, blanks_result, blanks));
+	ASSERT(strcmp(blanks, "b,a,b,c,b,c,") == 0);
+	anagram_query_destroy(&q);
+
+	/* Unused wildcards are left over in partial mode: */
+	blanks[0] = '\0';
+	q = anagram_query_create(dict, "c?", 2, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.partial   = true,
+		.minused   = 1,
+	});
+	ASSERT(anagram_query_run(q, leftover_result, blanks));
+	ASSERT(strcmp(blanks, "c,,c,,?,,") == 0);
+	anagram_query_destroy(&q);
+
+	/* Repeated letters, and results of three words: */
+	words[0] = blanks[0] = '\0';
+	q = anagram_query_create(dict, "aa?", 3, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+	});
+	ASSERT(anagram_query_run(q, join_result, words));
+	ASSERT(strcmp(words, "aba,aab,aaa,aab,aac,aba,aca,baa,caa,") == 0);
+	ASSERT(anagram_query_run(q, blanks_result, blanks));
+	ASSERT(strcmp(blanks, "b,b,a,b,c,b,c,b,c,") == 0);
+	anagram_query_destroy(&q);
+
+	/* In partial mode, with two wildcards and all letters used: */
+	n = 0;
+	blanks[0] = '\0';
+	q = anagram_query_create(dict, "abb??", 5, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 2,
+		.partial   = true,
+		.minused   = 5,
+	});
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 9);
+	ASSERT(anagram_query_run(q, blanks_result, blanks));
+	ASSERT(strcmp(blanks, "aa,ab,ac,aa,ab,ac,bb,bc,cc,") == 0);
+	anagram_query_destroy(&q);
+
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+// Append the words of a group to a string.
+static bool
+join_group (const struct anagram_group *group, void *arg)
+{
+	for (size_t i = 0; i < group->nwords; i++) {
+		strncat(arg, group->words[i]->str, group->words[i]->len);
+		strcat(arg, i + 1 < group->nwords ? " " : ",");
+	}
+	return true;
+}
+
+static int
+test_groups (void)
+{
+	int ret = 0;
+	char out[128] = "";
+	const char *words[] = { "abc", "listen", "xyz", "silent", "cab", "listen", "enlist", "zz" };
+	struct anagram_groups *g;
+
+	/* Groups come in the order of their first words, repeats count once: */
+	g = anagram_groups_create(NULL);
+	ASSERT(g != NULL);
+	for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		ASSERT(anagram_groups_add_word(g, words[i], strlen(words[i])));
+	}
+	ASSERT(anagram_groups_run(g, join_group, out));
+	ASSERT(strcmp(out, "abc cab,listen silent enlist,") == 0);
+	anagram_groups_destroy(&g);
+	ASSERT(g == NULL);
+
+	/* Only the larger group has three words: */
+	out[0] = '\0';
+	g = anagram_groups_create(&(struct anagram_groups_opts) { .minsize = 3, .nthreads = 2 });
+	for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		ASSERT(anagram_groups_add_word(g, words[i], strlen(words[i])));
+	}
+	ASSERT(anagram_groups_run(g, join_group, out));
+	ASSERT(strcmp(out, "listen silent enlist,") == 0);
+	anagram_groups_destroy(&g);
+	return ret;
+}
+
+// The results of a query as text, one per line.
+struct trace {
+	char buf[1 << 16];
+	size_t len;
+	bool overflow;
+};
+
+static void
+trace_put (struct trace *t, const char *str, size_t len)
+{
+	if (t->len + len >= sizeof(t->buf)) {
+		t->overflow = true;
+		return;
+	}
+
+	memcpy(t->buf + t->len, str, len);
+	t->buf[t->len += len] = '\0';
+}
+
+static bool
+trace_result (const struct anagram_result *result, void *arg)
+{
+	for (size_t i = 0; i < result->nwords; i++) {
+		trace_put(arg, result->words[i]->str, result->words[i]->len);
+		trace_put(arg, " ", 1);
+	}
+	trace_put(arg, "\t", 1);
+	trace_put(arg, result->leftover, result->nleftover);
+	trace_put(arg, "\t", 1);
+	trace_put(arg, result->blanks, result->nblanks);
+	trace_put(arg, "\n", 1);
+	return true;
+}
+
+static int
+test_generators (void)
+{
+	int ret = 0;
+	static struct trace trace[2];
+	const enum anagram_generator gens[2] = { ANAGRAM_GENERATOR_TRIE, ANAGRAM_GENERATOR_LIST };
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	const struct {
+		const char *input;
+		bool partial;
+		const char *include;
+	} cases[] = {
+		{ "aabbcc", false, NULL },
+		{ "aabbcc", true,  NULL },
+		{ "aab??c", false, NULL },
+		{ "ab?c",   true,  NULL },
+		{ "aabbcc", false, "ab" },
+		{ "aabbc?", true,  "ca" },
+	};
+
+	dict = dict_words((const char *[]) { "a", "b", "c", "ab", "ba", "abc", "cab", "aab", "bb", "cc", NULL });
+	ASSERT(dict != NULL);
+
+	/* Both generators find the same results in the same order: */
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		for (size_t g = 0; g < 2; g++) {
+			memset(&trace[g], 0, sizeof(trace[g]));
+			q = anagram_query_create(dict, cases[i].input, strlen(cases[i].input), &(struct anagram_query_opts) {
+				.minlength = 1,
+				.haslength = 1,
+				.include   = (const char *[]) { cases[i].include },
+				.ninclude  = cases[i].include != NULL,
+				.generator = gens[g],
+				.partial   = cases[i].partial,
+				.minused   = 2,
+			});
+			ASSERT(q != NULL);
+			ASSERT(anagram_query_run(q, trace_result, &trace[g]));
+			anagram_query_destroy(&q);
+		}
+		ASSERT(!trace[0].overflow && !trace[1].overflow);
+		ASSERT(trace[0].len > 0);
+		ASSERT(strcmp(trace[0].buf, trace[1].buf) == 0);
+	}
+
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+// Read back everything written to a stream.
+static size_t
+slurp (FILE *fp, char *buf, size_t size)
+{
+	rewind(fp);
+	return fread(buf, 1, size, fp);
+}
+
+static int
+test_output (void)
+{
+	int ret = 0;
+	char buf[512], word[201], path[] = "/tmp/anagram-test-XXXXXX";
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	struct output out;
+	size_t len;
+	FILE *fp;
+	int fd;
+
+	/* Quotes, backslashes and control characters are escaped in JSON: */
+	out = (struct output) { .format = OUTPUT_NDJSON, .fp = tmpfile() };
+	ASSERT(out.fp != NULL);
+	ASSERT(output_group(&(struct anagram_group) {
+		.words = (const struct anagram_word *[]) {
+			&(struct anagram_word) { "a\"b",  3 },
+			&(struct anagram_word) { "c\\d",  3 },
+			&(struct anagram_word) { "e\x01", 2 },
+		},
+		.nwords = 3,
+	}, &out));
+	len = slurp(out.fp, buf, sizeof(buf));
+	ASSERT(len == 36 && memcmp(buf, "{\"words\":[\"a\\\"b\",\"c\\\\d\",\"e\\u0001\"]}\n", len) == 0);
+	fclose(out.fp);
+
+	/* A word of 200 letters has a length of two varint bytes: */
+	memset(word, 'c', 200);
+	word[200] = '\0';
+	dict = dict_words((const char *[]) { "a", "b", "ab", word, NULL });
+	ASSERT(dict != NULL);
+	q = anagram_query_create(dict, "ab", 2, NULL);
+	ASSERT(q != NULL);
+
+	/* The binary stream has the table, then each result as its number
+	 * of words and their IDs, in the order of the text output: */
+	out = (struct output) { .format = OUTPUT_BINARY, .fp = tmpfile(), .query = q };
+	ASSERT(out.fp != NULL);
+	ASSERT(output_start(&out, NULL, false));
+	ASSERT(anagram_query_run(q, output_result, &out));
+	ASSERT(out.count == 3);
+	len = slurp(out.fp, buf, sizeof(buf));
+	ASSERT(len == 10 + 200 + 8);
+	ASSERT(memcmp(buf, "\x04\x01" "a" "\x01" "b" "\x02" "ab" "\xC8\x01", 10) == 0);
+	ASSERT(memcmp(buf + 10, word, 200) == 0);
+	ASSERT(memcmp(buf + 210, "\x02\x01\x00" "\x02\x00\x01" "\x01\x02", 8) == 0);
+	fclose(out.fp);
+
+	/* A resumed stream already has its table: */
+	out = (struct output) { .format = OUTPUT_BINARY, .fp = tmpfile(), .query = q };
+	ASSERT(out.fp != NULL);
+	ASSERT(output_start(&out, NULL, true));
+	ASSERT(slurp(out.fp, buf, sizeof(buf)) == 0);
+	fclose(out.fp);
+
+	/* With an index file, the table in the stream is empty: */
+	ASSERT((fd = mkstemp(path)) != -1);
+	close(fd);
+	out = (struct output) { .format = OUTPUT_BINARY, .fp = tmpfile(), .query = q };
+	ASSERT(out.fp != NULL);
+	ASSERT(output_start(&out, path, false));
+	len = slurp(out.fp, buf, sizeof(buf));
+	ASSERT(len == 1 && buf[0] == '\0');
+	fclose(out.fp);
+
+	/* The index file has one word per line: */
+	ASSERT((fp = fopen(path, "r")) != NULL);
+	len = slurp(fp, buf, sizeof(buf));
+	ASSERT(len == 7 + 201);
+	ASSERT(memcmp(buf, "a\nb\nab\n", 7) == 0);
+	ASSERT(memcmp(buf + 7, word, 200) == 0 && buf[207] == '\n');
+	fclose(fp);
+	unlink(path);
+
+	anagram_query_destroy(&q);
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+static int
+test_checkpoint (void)
+{
+	int ret = 0;
+	char full[512], resumed[512], path[] = "/tmp/anagram-test-XXXXXX", ckpt[64];
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	struct anagram_cursor *c;
+	struct output out;
+	size_t len;
+	long offset;
+	int fd;
+
+	dict = dict_words((const char *[]) { "a", "b", "c", "ab", "ba", "abc", "cab", NULL });
+	ASSERT(dict != NULL);
+	q = anagram_query_create(dict, "abc", 3, NULL);
+	ASSERT(q != NULL);
+
+	/* All results in one go, for reference: */
+	out = (struct output) { .format = OUTPUT_TEXT, .fp = tmpfile(), .query = q };
+	ASSERT(out.fp != NULL);
+	ASSERT(anagram_query_run(q, output_result, &out));
+	ASSERT(out.count > 4);
+	len = slurp(out.fp, full, sizeof(full));
+	fclose(out.fp);
+
+	ASSERT((fd = mkstemp(path)) != -1);
+	snprintf(ckpt, sizeof(ckpt), "%s.ckpt", path);
+	out = (struct output) { .format = OUTPUT_TEXT, .fp = fdopen(fd, "w+"), .query = q };
+	ASSERT(out.fp != NULL);
+
+	/* Write two results, save a checkpoint, and write two more: */
+	c = anagram_cursor_create(q);
+	ASSERT(anagram_cursor_next(c, 2, output_result, &out));
+	ASSERT(checkpoint_save(ckpt, c, out.fp));
+	offset = ftell(out.fp);
+	ASSERT(anagram_cursor_next(c, 2, output_result, &out));
+	ASSERT(fflush(out.fp) == 0 && ftell(out.fp) > offset);
+	anagram_cursor_destroy(&c);
+
+	/* Loading the checkpoint drops the output after it: */
+	c = anagram_cursor_create(q);
+	ASSERT(checkpoint_load(ckpt, c, out.fp));
+	ASSERT(ftell(out.fp) == offset);
+	ASSERT(lseek(fileno(out.fp), 0, SEEK_END) == offset);
+
+	/* The resumed search finishes the output without repeats: */
+	while (!anagram_cursor_done(c)) {
+		ASSERT(anagram_cursor_next(c, 1, output_result, &out));
+	}
+	ASSERT(slurp(out.fp, resumed, sizeof(resumed)) == len);
+	ASSERT(memcmp(full, resumed, len) == 0);
+	anagram_cursor_destroy(&c);
+
+	/* An output shorter than the checkpoint is an error: */
+	ASSERT(ftruncate(fileno(out.fp), offset - 1) == 0);
+	c = anagram_cursor_create(q);
+	errno = 0;
+	ASSERT(!checkpoint_load(ckpt, c, out.fp));
+	ASSERT(errno == EINVAL);
+	anagram_cursor_destroy(&c);
+
+	fclose(out.fp);
+	unlink(path);
+	unlink(ckpt);
+	anagram_query_destroy(&q);
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+static int
+test_cursor (void)
+{
+	int ret = 0;
+	int n = 0;
+	int total = 0;
+	unsigned char token[64];
+	size_t len;
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	struct anagram_cursor *c;
+
+	dict = dict_ab();
+	ASSERT(dict != NULL);
+	q = anagram_query_create(dict, "abab", 4, NULL);
+	ASSERT(anagram_query_run(q, count_result, &total));
+
+	/* Page through the results two at a time, each page on a new cursor: */
+	c = anagram_cursor_create(q);
+	len = anagram_cursor_save(c, token, sizeof(token));
+	anagram_cursor_destroy(&c);
+
+	for (int pages = 0; pages < total; pages++) {
+		c = anagram_cursor_create(q);
+		ASSERT(anagram_cursor_resume(c, token, len));
+		if (anagram_cursor_done(c)) {
+			anagram_cursor_destroy(&c);
+			break;
+		}
+		ASSERT(anagram_cursor_next(c, 2, count_result, &n));
+		len = anagram_cursor_save(c, token, sizeof(token));
+		ASSERT(len <= sizeof(token));
+		anagram_cursor_destroy(&c);
+	}
+	ASSERT(n == total);
+
+	/* With a limit of one level per call, every call can be resumed: */
+	n = 0;
+	c = anagram_cursor_create(q);
+	anagram_cursor_limit(c, 1);
+	for (int calls = 0; calls < 100 && !anagram_cursor_done(c); calls++) {
+		struct anagram_cursor *r = anagram_cursor_create(q);
+
+		len = anagram_cursor_save(c, token, sizeof(token));
+		ASSERT(anagram_cursor_resume(r, token, len));
+		anagram_cursor_limit(r, 1);
+		ASSERT(anagram_cursor_next(r, SIZE_MAX, count_result, &n));
+		anagram_cursor_destroy(&c);
+		c = r;
+	}
+	ASSERT(anagram_cursor_done(c));
+	ASSERT(n == total);
+	anagram_cursor_destroy(&c);
+
+	/* Tokens from a different query are rejected: */
+	anagram_query_destroy(&q);
+	q = anagram_query_create(dict, "aabb", 4, &(struct anagram_query_opts) { .minlength = 2, .haslength = 1 });
+	c = anagram_cursor_create(q);
+	ASSERT(!anagram_cursor_resume(c, token, len));
+	anagram_cursor_destroy(&c);
+
+	anagram_query_destroy(&q);
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+static int
+test_prune (void)
+{
+	int ret = 0;
+	int n = 0;
+	struct anagram_dict *dict;
+	struct anagram_query *q;
+	struct anagram_cursor *c;
+	struct anagram_search_stats stats;
+
+	dict = anagram_dict_create(NULL);
+	ASSERT(anagram_dict_add_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, "aa", 2));
+
+	/* No word contains the 'c': */
+	q = anagram_query_create(dict, "abc", 3, NULL);
+	c = anagram_cursor_create(q);
+	ASSERT(anagram_cursor_next(c, 10, count_result, &n));
+	anagram_cursor_stats(c, &stats);
+	ASSERT(n == 0);
+	ASSERT(stats.pruned_letter == 1);
+	anagram_cursor_destroy(&c);
+	anagram_query_destroy(&q);
+
+	/* Five letters cannot be made from words of length two: */
+	q = anagram_query_create(dict, "aaaab", 5, NULL);
+	c = anagram_cursor_create(q);
+	ASSERT(anagram_cursor_next(c, 10, count_result, &n));
+	anagram_cursor_stats(c, &stats);
+	ASSERT(n == 0);
+	ASSERT(stats.pruned_length == 1);
+	ASSERT(stats.levels == 1);
+	anagram_cursor_destroy(&c);
+	anagram_query_destroy(&q);
+
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
+static int
+test_query (void)
+{
+	int ret = 0;
+	int n = 0;
+	struct anagram_dict *dict;
+	struct anagram_dict_stats stats;
+	struct anagram_query *q;
+
+	dict = dict_ab();
+	ASSERT(dict != NULL);
+	ASSERT(anagram_dict_add_word(dict, "xyz", 3));
+	ASSERT(anagram_dict_size(dict) == 4);
+
+	/* 'ab', 'a b', 'b a': */
+	q = anagram_query_create(dict, "ab", 2, NULL);
+	ASSERT(q != NULL);
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 3);
+
+	/* The callback can stop the search: */
+	n = 0;
+	ASSERT(anagram_query_run(q, stop_result, &n));
+	ASSERT(n == 1);
+	anagram_query_destroy(&q);
+	ASSERT(q == NULL);
+
+	/* Only 'ab' has a word of length two: */
+	n = 0;
+	q = anagram_query_create(dict, "ab", 2, &(struct anagram_query_opts) { .minlength = 1, .haslength = 2 });
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 1);
+	anagram_query_destroy(&q);
+
+	/* Included words are subtracted up front, 'ab' leaves only 'b': */
+	n = 0;
+	q = anagram_query_create(dict, "ab", 2, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.include   = (const char *[]) { "a" },
+		.ninclude  = 1,
+	});
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 1);
+
+	/* Word IDs are dictionary indices, followed by the included words: */
+	ASSERT(anagram_query_nwords(q) == 5);
+	ASSERT(strcmp(anagram_query_word(q, 2)->str, "b") == 0);
+	ASSERT(strcmp(anagram_query_word(q, 4)->str, "a") == 0);
+	ASSERT(anagram_query_word(q, 5) == NULL);
+	for (size_t i = 0; i < 5; i++) {
+		ASSERT(anagram_query_word_id(q, anagram_query_word(q, i)) == i);
+	}
+	anagram_query_destroy(&q);
+
+	/* Included words which do not fit fail the query: */
+	q = anagram_query_create(dict, "ab", 2, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.include   = (const char *[]) { "aa" },
+		.ninclude  = 1,
+	});
+	ASSERT(q == NULL);
+	anagram_dict_destroy(&dict);
+	ASSERT(dict == NULL);
+
+	/* Excluded words are dropped when added: */
+	dict = anagram_dict_create(NULL);
+	ASSERT(anagram_dict_exclude_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, "a", 1));
+	ASSERT(anagram_dict_size(dict) == 1);
+	anagram_dict_destroy(&dict);
+
+	/* Words below the minimum length are dropped while loading: */
+	dict = anagram_dict_create(&(struct anagram_dict_opts) { .minlength = 2 });
+	ASSERT(anagram_dict_add_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, "a", 1));
+	ASSERT(anagram_dict_size(dict) == 1);
+	anagram_dict_destroy(&dict);
+
+	/* Duplicates are dropped, also after normalization: */
+	dict = anagram_dict_create(&(struct anagram_dict_opts) { .normalize = true });
+	ASSERT(anagram_dict_add_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, "ab", 2));
+	ASSERT(anagram_dict_add_word(dict, " AB\r", 4));
+	ASSERT(anagram_dict_add_word(dict, "ba", 2));
+	ASSERT(anagram_dict_size(dict) == 2);
+	anagram_dict_stats(dict, &stats);
+	ASSERT(stats.offered == 4);
+	ASSERT(stats.duplicates == 2);
+
+	/* Included words are normalized like the dictionary words: */
+	n = 0;
+	q = anagram_query_create(dict, "abba", 4, &(struct anagram_query_opts) {
+		.minlength = 1,
+		.haslength = 1,
+		.include   = (const char *[]) { " AB " },
+		.ninclude  = 1,
+	});
+	ASSERT(q != NULL);
+	ASSERT(anagram_query_run(q, count_result, &n));
+	ASSERT(n == 2);
+	anagram_query_destroy(&q);
+	anagram_dict_destroy(&dict);
+	return ret;
+}
+
 int
 main ()
 {
@@ -91,5 +857,31 @@ main ()
 	ASSERT(hf->freq[2] == 0);
 	ASSERT(hf->ntotal == 0);
 
+	/* Subtracting 'a' from 'abb' leaves a max frequency of two: */
+	histogram_destroy(&hf);
+	hf = histogram_create("abb", 3);
+	ASSERT(histogram_subtract(hf, hc) == 1);
+	ASSERT(hf->maxfreq == 2);
+	ASSERT(hf->ntotal == 2);
+
+	/* A wildcard covers a missing letter, and is used up by it: */
+	histogram_destroy(&hf);
+	hf = histogram_create("a?", 2);
+	ASSERT(hf->len == 1);
+	ASSERT(hf->nwild == 1);
+	ASSERT(hf->ntotal == 2);
+	ASSERT(histogram_fits(hc, hf) == 1);
+	ASSERT(histogram_fits(hb, hf) == 0);
+	ASSERT(histogram_fits(ha, hf) == 0);
+	ASSERT(histogram_subtract(hf, hc) == 1);
+	ASSERT(hf->nwild == 1);
+	ASSERT(histogram_subtract(hf, hc) == 1);
+	ASSERT(hf->nwild == 0);
+	ASSERT(hf->ntotal == 0);
+
+	if (test_query() != 0 || test_cursor() != 0 || test_prune() != 0 || test_generators() != 0 || test_partial() != 0 || test_wildcard() != 0 || test_groups() != 0 || test_cache() != 0 || test_output() != 0 || test_checkpoint() != 0) {
+		ret = 1;
+	}
+
 	return ret;
 }